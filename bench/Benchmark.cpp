@@ -0,0 +1,613 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MappedFile.h"
+#include "PatternSet.h"
+#include "SimdScanner.h"
+#include "SuffixIndex.h"
+#include "ViewData.h"
+
+#include <mem/mem.h>
+#include <mem/pattern.h>
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using stopwatch = std::chrono::steady_clock;
+
+struct BenchmarkResult
+{
+    double seconds {0.0};
+    uint64_t cycles {0};
+    size_t results {0};
+};
+
+// Returns the fastest of several runs
+template <typename Func>
+BenchmarkResult RunBenchmark(size_t runs, Func func)
+{
+    BenchmarkResult best;
+
+    for (size_t i = 0; i < runs; ++i)
+    {
+        const auto start_time = stopwatch::now();
+        const auto start_cycles = mem::rdtsc();
+
+        const size_t results = func();
+
+        const auto end_cycles = mem::rdtsc();
+        const auto end_time = stopwatch::now();
+
+        const double seconds = std::chrono::duration<double>(end_time - start_time).count();
+
+        if ((i == 0) || (seconds < best.seconds))
+        {
+            best.seconds = seconds;
+            best.cycles = end_cycles - start_cycles;
+            best.results = results;
+        }
+    }
+
+    return best;
+}
+
+void ReportThroughput(const std::string& corpus, const std::string& name, size_t bytes, const BenchmarkResult& result)
+{
+    fmt::print("{:<12} {:<56} {:>8.2f} GB/s {:>8.3f} cycles/byte {:>10} results\n", corpus, name,
+        (bytes / 1073741824.0) / std::max(result.seconds, 1e-9), double(result.cycles) / double(bytes), result.results);
+}
+
+void ReportRate(const std::string& corpus, const std::string& name, size_t count, const BenchmarkResult& result)
+{
+    fmt::print("{:<12} {:<56} {:>8.1f} ms {:>12.0f} per second {:>10} results\n", corpus, name, result.seconds * 1000.0,
+        count / std::max(result.seconds, 1e-9), result.results);
+}
+
+std::vector<uint8_t> CreateRandomCorpus(size_t size, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> result(size);
+
+    for (uint8_t& value : result)
+    {
+        value = static_cast<uint8_t>(rng());
+    }
+
+    return result;
+}
+
+// Random instructions from a list of common x86-64 encodings, so byte frequencies and candidate rates resemble real code
+std::vector<uint8_t> CreateCodeCorpus(size_t size, uint32_t seed)
+{
+    static const char* const instructions[] {
+        "48 89 5C 24 ?", "48 89 74 24 ?", "48 83 EC ?", "48 83 C4 ?", "48 8B 05 ? ? ? ?", "48 8B 0D ? ? ? ?",
+        "48 8D 0D ? ? ? ?", "48 8D 15 ? ? ? ?", "48 8B C8", "48 8B D9", "4C 8B C3", "48 85 C0", "85 C0", "33 C0",
+        "33 D2", "74 ?", "75 ?", "EB ?", "0F 84 ? ? ? ?", "0F 85 ? ? ? ?", "E8 ? ? ? ?", "E9 ? ? ? ?",
+        "FF 15 ? ? ? ?", "41 B8 ? ? ? ?", "B9 ? ? ? ?", "89 44 24 ?", "8B 44 24 ?", "0F B6 C0", "48 63 C8",
+        "C3", "CC", "90", "5B", "5F", "40 53", "57", "48 3B C3", "C7 44 24 ? ? ? ? ?",
+    };
+
+    std::vector<mem::pattern> patterns;
+
+    for (const char* instruction : instructions)
+    {
+        patterns.emplace_back(instruction);
+    }
+
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> result;
+
+    result.reserve(size + 16);
+
+    while (result.size() < size)
+    {
+        const mem::pattern& pattern = patterns[rng() % patterns.size()];
+
+        for (size_t i = 0; i < pattern.size(); ++i)
+        {
+            // Displacements and immediates are mostly small
+            const uint8_t random = static_cast<uint8_t>((rng() % 4) ? (rng() % 0x40) : rng());
+
+            result.push_back(static_cast<uint8_t>((pattern.bytes()[i] & pattern.masks()[i]) | (random & ~pattern.masks()[i])));
+        }
+    }
+
+    result.resize(size);
+
+    return result;
+}
+
+std::shared_ptr<brick::view_data> CreateViewData(const uint8_t* data, size_t size)
+{
+    std::shared_ptr<brick::view_data> result = std::make_shared<brick::view_data>();
+
+    result->segments.emplace_back(0x140000000, size, data);
+
+    return result;
+}
+
+// A pattern copied from the corpus, with every few bytes replaced by a wildcard
+mem::pattern SamplePatternAt(const uint8_t* data, size_t offset, size_t length, std::mt19937& rng)
+{
+    std::vector<uint8_t> masks(length, 0xFF);
+
+    for (size_t i = 1; i < length; ++i)
+    {
+        if ((rng() % 4) == 0)
+            masks[i] = 0x00;
+    }
+
+    return mem::pattern(data + offset, masks.data(), length);
+}
+
+mem::pattern SamplePattern(const uint8_t* data, size_t size, size_t length, std::mt19937& rng)
+{
+    const size_t offset = rng() % (size - length);
+
+    return SamplePatternAt(data, offset, length, rng);
+}
+
+template <typename Scanner>
+std::vector<uint64_t> FindAll(const Scanner& scanner, const uint8_t* data, size_t size, uint64_t base)
+{
+    std::vector<uint64_t> results;
+
+    scanner(mem::region { data, size }, [&] (mem::pointer result)
+    {
+        results.push_back(base + static_cast<uint64_t>(result.as<const uint8_t*>() - data));
+
+        return false;
+    });
+
+    return results;
+}
+
+// Compares every scanner against mem::default_scanner, so the timings are only reported for correct results
+class ScanVerifier
+{
+public:
+    explicit ScanVerifier(const std::string& corpus)
+        : corpus_(corpus)
+    { }
+
+    size_t failures() const
+    {
+        return failures_;
+    }
+
+    void check(const std::string& name, const std::vector<uint64_t>& expected, const std::vector<uint64_t>& results)
+    {
+        if (results == expected)
+            return;
+
+        // Only the first few are worth reading
+        if (failures_++ >= 10)
+            return;
+
+        size_t index = 0;
+
+        while ((index < expected.size()) && (index < results.size()) && (expected[index] == results[index]))
+            ++index;
+
+        fmt::print("{:<12} MISMATCH {}: {} results, expected {}, first difference at index {} ({} != {})\n", corpus_, name,
+            results.size(), expected.size(), index, (index < results.size()) ? fmt::format("{:#x}", results[index]) : "end",
+            (index < expected.size()) ? fmt::format("{:#x}", expected[index]) : "end");
+    }
+
+    void check(const std::string& name, uint64_t expected, uint64_t result)
+    {
+        check(name, std::vector<uint64_t> { expected }, std::vector<uint64_t> { result });
+    }
+
+private:
+    std::string corpus_;
+    size_t failures_ {0};
+};
+
+static const std::pair<const char*, brick::simd_scanner::kernel> ScannerKernels[] {
+    { "scalar", brick::simd_scanner::kernel::scalar },
+    { "sse2", brick::simd_scanner::kernel::sse2 },
+    { "avx2", brick::simd_scanner::kernel::avx2 },
+};
+
+// Scans of the whole corpus, split into chunks on all threads by scan_all, including matches which cross the chunks
+void VerifyChunkedScans(ScanVerifier& verifier, const uint8_t* data, size_t size)
+{
+    std::mt19937 rng(4321);
+
+    std::shared_ptr<const brick::view_data> view = CreateViewData(data, size);
+
+    const uint64_t base = view->segments.front().start;
+
+    std::vector<mem::pattern> patterns;
+
+    patterns.emplace_back("48 8B 05 ? ? ? ? 48 85 C0");
+    patterns.emplace_back("E8 ? ? ? ? 90");
+    patterns.emplace_back("DE AD BE EF");
+
+    for (size_t length : { 2, 5, 16, 33, 64 })
+    {
+        patterns.push_back(SamplePattern(data, size, length, rng));
+    }
+
+    // Matches which only fit in the overlap with the next chunk, and short ones within the overlap which both chunks scan
+    for (size_t i = 1; (i <= 3) && (i * brick::view_data::scan_partition_size + 32 <= size); ++i)
+    {
+        patterns.push_back(SamplePatternAt(data, i * brick::view_data::scan_partition_size - 1, 24, rng));
+        patterns.push_back(SamplePatternAt(data, i * brick::view_data::scan_partition_size + 2, 4, rng));
+    }
+
+    brick::pattern_set set;
+
+    std::vector<std::vector<uint64_t>> expected;
+
+    for (const mem::pattern& pattern : patterns)
+    {
+        const std::string name = fmt::format("pattern {}", expected.size());
+
+        set.add(pattern);
+
+        mem::default_scanner reference(pattern);
+
+        expected.push_back(FindAll(reference, data, size, base));
+
+        verifier.check("mem::default_scanner scan_all, " + name, expected.back(), view->scan_all(reference, pattern.size()));
+
+        for (const auto& kernel : ScannerKernels)
+        {
+            for (const brick::byte_histogram* histogram : { static_cast<const brick::byte_histogram*>(nullptr), &view->histogram() })
+            {
+                brick::simd_scanner scanner(pattern, histogram);
+
+                if (!scanner.use_kernel(kernel.second))
+                    continue;
+
+                const std::string scanner_name = fmt::format("simd_scanner ({}{}), {}", kernel.first, histogram ? ", histogram" : "", name);
+
+                verifier.check(scanner_name, expected.back(), FindAll(scanner, data, size, base));
+                verifier.check(scanner_name + " scan_all", expected.back(), view->scan_all(scanner, pattern.size()));
+                verifier.check(scanner_name + " scan", expected.back().empty() ? 0 : expected.back().front(), view->scan(scanner, pattern.size()));
+            }
+        }
+    }
+
+    set.compile();
+
+    const brick::pattern_set_results set_results = view->scan_all(set);
+
+    for (size_t i = 0; i < patterns.size(); ++i)
+    {
+        verifier.check(fmt::format("pattern_set scan_all, pattern {}", i), expected[i],
+            std::vector<uint64_t>(set_results.data(i), set_results.data(i) + set_results.count(i)));
+    }
+}
+
+// Every start and end alignment of a small window, with matches at both ends, so each kernel's tail handling is used
+void VerifyUnalignedScans(ScanVerifier& verifier, const uint8_t* data, size_t size)
+{
+    std::mt19937 rng(5678);
+
+    const size_t window = std::min<size_t>(size, 512);
+
+    std::vector<mem::pattern> patterns;
+
+    for (size_t length : { 1, 2, 4, 15, 16, 17, 31, 32, 33, 48 })
+    {
+        patterns.push_back(SamplePatternAt(data, 0, length, rng));
+        patterns.push_back(SamplePatternAt(data, window - length, length, rng));
+    }
+
+    // Nothing but partial wildcards, so no anchor bytes can be picked
+    const uint8_t masks[] { 0xF0, 0x00, 0x0F };
+
+    patterns.emplace_back(data + window / 2, masks, sizeof(masks));
+
+    brick::pattern_set set;
+
+    for (const mem::pattern& pattern : patterns)
+    {
+        set.add(pattern);
+    }
+
+    set.compile();
+
+    for (size_t start = 0; start <= 40; ++start)
+    {
+        for (size_t end = window - 40; end <= window; ++end)
+        {
+            std::vector<std::vector<uint64_t>> set_results(patterns.size());
+
+            set(mem::region { data + start, end - start }, [&] (size_t index, mem::pointer result)
+            {
+                set_results[index].push_back(static_cast<uint64_t>(result.as<const uint8_t*>() - data));
+
+                return false;
+            });
+
+            for (size_t i = 0; i < patterns.size(); ++i)
+            {
+                const std::string name = fmt::format("pattern {} in [{}, {})", i, start, end);
+
+                const std::vector<uint64_t> expected = FindAll(mem::default_scanner(patterns[i]), data + start, end - start, start);
+
+                verifier.check("pattern_set, " + name, expected, set_results[i]);
+
+                for (const auto& kernel : ScannerKernels)
+                {
+                    brick::simd_scanner scanner(patterns[i]);
+
+                    if (scanner.use_kernel(kernel.second))
+                    {
+                        verifier.check(fmt::format("simd_scanner ({}), {}", kernel.first, name), expected,
+                            FindAll(scanner, data + start, end - start, start));
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool VerifyCorpus(const std::string& corpus, const uint8_t* data, size_t size)
+{
+    ScanVerifier verifier(corpus);
+
+    VerifyChunkedScans(verifier, data, size);
+    VerifyUnalignedScans(verifier, data, size);
+
+    if (verifier.failures())
+    {
+        fmt::print("{:<12} {} mismatched scans\n", corpus, verifier.failures());
+
+        return false;
+    }
+
+    return true;
+}
+
+bool RunCorpus(const std::string& corpus, const uint8_t* data, size_t size, size_t runs)
+{
+    if (!VerifyCorpus(corpus, data, size))
+    {
+        return false;
+    }
+
+    std::mt19937 rng(1234);
+
+    {
+        BenchmarkResult result = RunBenchmark(runs, [&] ()
+        {
+            // The histogram is cached, so every run needs a fresh snapshot
+            const brick::byte_histogram& histogram = CreateViewData(data, size)->histogram();
+
+            return static_cast<size_t>(std::count_if(histogram.begin(), histogram.end(), [] (uint64_t count)
+            {
+                return count != 0;
+            }));
+        });
+
+        ReportThroughput(corpus, "histogram", size, result);
+    }
+
+    std::shared_ptr<const brick::view_data> view = CreateViewData(data, size);
+
+    std::vector<std::pair<std::string, mem::pattern>> patterns;
+
+    patterns.emplace_back("common (48 8B 05 ? ? ? ? 48 85 C0)", mem::pattern("48 8B 05 ? ? ? ? 48 85 C0"));
+    patterns.emplace_back("call (E8 ? ? ? ? 90)", mem::pattern("E8 ? ? ? ? 90"));
+    patterns.emplace_back("rare (DE AD BE EF)", mem::pattern("DE AD BE EF"));
+    patterns.emplace_back("sampled (16 bytes)", SamplePattern(data, size, 16, rng));
+
+    for (const auto& entry : patterns)
+    {
+        const mem::pattern& pattern = entry.second;
+
+        {
+            mem::default_scanner scanner(pattern);
+
+            ReportThroughput(corpus, "mem::default_scanner, " + entry.first, size, RunBenchmark(runs, [&]
+            {
+                return view->scan_all(scanner, pattern.size()).size();
+            }));
+        }
+
+        {
+            brick::simd_scanner scanner(pattern);
+
+            ReportThroughput(corpus, "simd_scanner, " + entry.first, size, RunBenchmark(runs, [&]
+            {
+                return view->scan_all(scanner, pattern.size()).size();
+            }));
+
+            ReportThroughput(corpus, "simd_scanner (1 thread), " + entry.first, size, RunBenchmark(runs, [&]
+            {
+                size_t total = 0;
+
+                (*view)(scanner, [&] (uint64_t)
+                {
+                    ++total;
+
+                    return false;
+                });
+
+                return total;
+            }));
+        }
+
+        {
+            brick::simd_scanner scanner(pattern, &view->histogram());
+
+            ReportThroughput(corpus, "simd_scanner (histogram), " + entry.first, size, RunBenchmark(runs, [&]
+            {
+                return view->scan_all(scanner, pattern.size()).size();
+            }));
+        }
+    }
+
+    for (size_t count : { 1000, 10000 })
+    {
+        brick::pattern_set set;
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            set.add(SamplePattern(data, size, 8 + (rng() % 17), rng));
+        }
+
+        ReportRate(corpus, fmt::format("pattern_set compile ({} patterns)", count), count, RunBenchmark(runs, [&]
+        {
+            brick::pattern_set copy = set;
+
+            copy.compile();
+
+            return copy.size();
+        }));
+
+        set.compile();
+
+        ReportThroughput(corpus, fmt::format("pattern_set scan ({} patterns)", count), size, RunBenchmark(runs, [&]
+        {
+            return view->scan_all(set).addresses.size();
+        }));
+    }
+
+    // The uniqueness queries made while creating signatures, on a slice small enough to index quickly
+    const size_t index_size = std::min<size_t>(size, 16 << 20);
+
+    std::shared_ptr<const brick::view_data> index_view = CreateViewData(data, index_size);
+    std::shared_ptr<const brick::suffix_index> index;
+
+    ReportThroughput(corpus, fmt::format("suffix_index build ({} MiB)", index_size >> 20), index_size, RunBenchmark(1, [&]
+    {
+        index = std::make_shared<brick::suffix_index>(index_view);
+
+        return size_t(0);
+    }));
+
+    std::vector<mem::pattern> queries;
+
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        queries.push_back(SamplePattern(data, index_size, 5 + (rng() % 12), rng));
+    }
+
+    ReportRate(corpus, "suffix_index queries", queries.size(), RunBenchmark(runs, [&]
+    {
+        size_t total = 0;
+
+        for (const mem::pattern& query : queries)
+        {
+            total += index->find(query, 2).size();
+        }
+
+        return total;
+    }));
+
+    ReportRate(corpus, "simd_scanner queries", 20, RunBenchmark(runs, [&]
+    {
+        size_t total = 0;
+
+        for (size_t i = 0; i < 20; ++i)
+        {
+            total += index_view->scan_all(brick::simd_scanner(queries[i], &index_view->histogram()), queries[i].size()).size();
+        }
+
+        return total;
+    }));
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    size_t size = 128 << 20;
+    size_t runs = 5;
+
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+
+        if ((arg == "--size") && (i + 1 < argc))
+        {
+            size = std::stoull(argv[++i]) << 20;
+        }
+        else if ((arg == "--runs") && (i + 1 < argc))
+        {
+            runs = std::max<size_t>(std::stoull(argv[++i]), 1);
+        }
+        else if ((arg == "--help") || (arg == "-h"))
+        {
+            fmt::print("Usage: {} [--size <MiB>] [--runs <count>] [file...]\n", argv[0]);
+            fmt::print("Benchmarks scanning synthetic random and x86-like data, and any given raw files\n");
+            fmt::print("Every scanner is first checked against mem::default_scanner, failing the run if any results differ\n");
+
+            return 0;
+        }
+        else
+        {
+            files.push_back(arg);
+        }
+    }
+
+    fmt::print("{} threads, best of {} runs\n\n", parallel_get_thread_count(), runs);
+
+    if (size < 0x100)
+    {
+        fmt::print("Corpus size is too small\n");
+
+        return 1;
+    }
+
+    bool verified = true;
+
+    {
+        std::vector<uint8_t> corpus = CreateRandomCorpus(size, 1);
+
+        verified &= RunCorpus("random", corpus.data(), corpus.size(), runs);
+    }
+
+    {
+        // An odd size, so the last chunk ends in every kernel's tail handling
+        std::vector<uint8_t> corpus = CreateCodeCorpus(size - 13, 2);
+
+        verified &= RunCorpus("x86", corpus.data(), corpus.size(), runs);
+    }
+
+    for (const std::string& file_name : files)
+    {
+        brick::mapped_file file;
+
+        if (!file.open(file_name) || (file.size() < 0x100))
+        {
+            fmt::print("Failed to open \"{}\"\n", file_name);
+
+            continue;
+        }
+
+        verified &= RunCorpus(file_name, file.data(), file.size(), runs);
+    }
+
+    return verified ? 0 : 1;
+}
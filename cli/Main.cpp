@@ -0,0 +1,370 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ImageSource.h"
+#include "PatternResolver.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using stopwatch = std::chrono::steady_clock;
+
+struct Options
+{
+    std::string pattern_file;
+    std::vector<std::string> input_files;
+
+    std::string output_file;
+    bool csv {false};
+
+    bool raw {false};
+    uint64_t base {0};
+
+    bool quiet {false};
+};
+
+static void PrintUsage(const char* program)
+{
+    fmt::print(stderr,
+        "Usage: {} [options] <pattern file> <binary>...\n"
+        "Resolves every pattern in a YAML pattern file or pattern database against ELF, PE or raw files\n"
+        "\n"
+        "Options:\n"
+        "  -f, --format <json|csv>  Output format (default json)\n"
+        "  -o, --output <file>      Write the results to a file instead of stdout\n"
+        "      --raw                Map the inputs as raw data, instead of detecting ELF/PE\n"
+        "      --base <address>     Base address of raw inputs (default 0)\n"
+        "  -q, --quiet              Only log errors\n"
+        "\n"
+        "Exits with 1 if any file could not be loaded, or 2 if any pattern was not resolved\n",
+        program);
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options)
+{
+    std::vector<std::string> positional;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+
+        const auto next = [&] () -> const char*
+        {
+            return (i + 1 < argc) ? argv[++i] : nullptr;
+        };
+
+        if ((arg == "-f") || (arg == "--format"))
+        {
+            const char* value = next();
+
+            if (!value)
+                return false;
+
+            if (!std::strcmp(value, "csv"))
+                options.csv = true;
+            else if (!std::strcmp(value, "json"))
+                options.csv = false;
+            else
+                return false;
+        }
+        else if ((arg == "-o") || (arg == "--output"))
+        {
+            const char* value = next();
+
+            if (!value)
+                return false;
+
+            options.output_file = value;
+        }
+        else if (arg == "--raw")
+        {
+            options.raw = true;
+        }
+        else if (arg == "--base")
+        {
+            const char* value = next();
+
+            if (!value)
+                return false;
+
+            char* end = nullptr;
+
+            options.base = std::strtoull(value, &end, 0);
+
+            if (*end)
+                return false;
+        }
+        else if ((arg == "-q") || (arg == "--quiet"))
+        {
+            options.quiet = true;
+        }
+        else if ((arg.size() > 1) && (arg[0] == '-'))
+        {
+            return false;
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() < 2)
+    {
+        return false;
+    }
+
+    options.pattern_file = positional[0];
+    options.input_files.assign(positional.begin() + 1, positional.end());
+
+    return true;
+}
+
+static const char* GetLevelName(brick::log_level level)
+{
+    switch (level)
+    {
+        case brick::log_level::debug: return "debug";
+        case brick::log_level::info: return "info";
+        case brick::log_level::warning: return "warning";
+        case brick::log_level::error: return "error";
+    }
+
+    return "error";
+}
+
+static const char* GetFormatName(brick::image_source::image_format format, size_t address_size)
+{
+    switch (format)
+    {
+        case brick::image_source::image_format::raw: return "raw";
+        case brick::image_source::image_format::elf: return (address_size == 8) ? "elf64" : "elf32";
+        case brick::image_source::image_format::pe: return (address_size == 8) ? "pe64" : "pe32";
+    }
+
+    return "raw";
+}
+
+static std::string EscapeJson(const char* value)
+{
+    std::string result;
+
+    for (; *value; ++value)
+    {
+        const unsigned char c = static_cast<unsigned char>(*value);
+
+        switch (c)
+        {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+
+            default:
+            {
+                if (c < 0x20)
+                    result += fmt::format("\\u{:04x}", c);
+                else
+                    result += static_cast<char>(c);
+            } break;
+        }
+    }
+
+    return result;
+}
+
+static std::string EscapeCsv(const std::string& value)
+{
+    if (value.find_first_of(",\"\r\n") == std::string::npos)
+    {
+        return value;
+    }
+
+    std::string result = "\"";
+
+    for (char c : value)
+    {
+        if (c == '"')
+            result += '"';
+
+        result += c;
+    }
+
+    result += '"';
+
+    return result;
+}
+
+// Writes the results for one input file
+static void WriteResults(std::FILE* output, const Options& options, const std::string& file_name,
+    const brick::image_source& source, const brick::pattern_database& database,
+    const std::vector<brick::pattern_result>& results, bool first)
+{
+    if (options.csv)
+    {
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const brick::pattern_database::entry info = database[i];
+
+            fmt::print(output, "{},{},{},{}\n", EscapeCsv(file_name), EscapeCsv(info.name), EscapeCsv(info.category),
+                results[i].found ? fmt::format("0x{:X}", results[i].offset) : std::string());
+        }
+
+        return;
+    }
+
+    fmt::print(output, "{}  {{\n", first ? "" : ",\n");
+    fmt::print(output, "    \"file\": \"{}\",\n", EscapeJson(file_name.c_str()));
+    fmt::print(output, "    \"format\": \"{}\",\n", GetFormatName(source.format(), source.address_size()));
+    fmt::print(output, "    \"results\": [");
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const brick::pattern_database::entry info = database[i];
+
+        // Addresses are strings, since JSON numbers can't hold every 64-bit value
+        fmt::print(output, "{}\n      {{ \"name\": \"{}\", \"category\": \"{}\", \"found\": {}, \"address\": {} }}",
+            i ? "," : "", EscapeJson(info.name), EscapeJson(info.category), results[i].found ? "true" : "false",
+            results[i].found ? fmt::format("\"0x{:X}\"", results[i].offset) : std::string("null"));
+    }
+
+    fmt::print(output, "{}]\n  }}", results.empty() ? "" : "\n    ");
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage(argv[0]);
+
+        return 1;
+    }
+
+    const std::string* current_file = &options.pattern_file;
+
+    const brick::log_function log = [&] (brick::log_level level, const std::string& message)
+    {
+        if (options.quiet && (level != brick::log_level::error))
+        {
+            return;
+        }
+
+        fmt::print(stderr, "[{}] {}: {}\n", GetLevelName(level), *current_file, message);
+    };
+
+    const auto start_time = stopwatch::now();
+
+    brick::expression_stats expression_stats;
+    brick::pattern_database database;
+
+    if (!brick::load_pattern_file(options.pattern_file, database, expression_stats, log))
+    {
+        return 1;
+    }
+
+    std::FILE* output = stdout;
+
+    if (!options.output_file.empty())
+    {
+        output = std::fopen(options.output_file.c_str(), "wb");
+
+        if (!output)
+        {
+            fmt::print(stderr, "Failed to open \"{}\"\n", options.output_file);
+
+            return 1;
+        }
+    }
+
+    int exit_code = 0;
+    size_t written = 0;
+
+    if (options.csv)
+        fmt::print(output, "file,name,category,address\n");
+    else
+        fmt::print(output, "[\n");
+
+    for (const std::string& file_name : options.input_files)
+    {
+        current_file = &file_name;
+
+        brick::image_source source;
+
+        const bool loaded = options.raw ? source.open_raw(file_name, options.base) : source.open(file_name, options.base);
+
+        if (!loaded)
+        {
+            log(brick::log_level::error, "Failed to load file");
+
+            exit_code = 1;
+
+            continue;
+        }
+
+        brick::resolve_timings timings;
+
+        brick::resolve_results resolved = brick::resolve_patterns(source, database, &timings);
+        const std::vector<brick::pattern_result>& results = resolved.entries;
+
+        for (const brick::pattern_message& message : resolved.messages)
+        {
+            log(message.level, message.text);
+        }
+
+        const size_t found = std::count_if(results.begin(), results.end(), [ ] (const brick::pattern_result& result)
+        {
+            return result.found;
+        });
+
+        if ((found != results.size()) && (exit_code == 0))
+        {
+            exit_code = 2;
+        }
+
+        log(brick::log_level::info, fmt::format("Resolved {} of {} patterns (scan {} ms, evaluate {} ms)", found,
+            results.size(), std::chrono::duration_cast<std::chrono::milliseconds>(timings.scan).count(),
+            std::chrono::duration_cast<std::chrono::milliseconds>(timings.evaluate).count()));
+
+        WriteResults(output, options, file_name, source, database, results, written++ == 0);
+    }
+
+    if (!options.csv)
+        fmt::print(output, "{}]\n", written ? "\n" : "");
+
+    if (output != stdout)
+        std::fclose(output);
+
+    current_file = &options.pattern_file;
+
+    const auto end_time = stopwatch::now();
+
+    log(brick::log_level::info, fmt::format("Processed {} files in {} ms ({} expressions compiled, {} cached)",
+        options.input_files.size(), std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count(),
+        expression_stats.misses.load(), expression_stats.hits.load()));
+
+    return exit_code;
+}
@@ -34,69 +34,44 @@ void BinjaLog(BNLogLevel level, const String& format, const Args&... args)
     BNLog(level, "%s", fmt::format(format, args...).c_str());
 }
 
-#include <mem/mem.h>
-#include <memory>
+#include "ViewData.h"
 
 namespace brick
 {
-    struct view_segment
+    // Copies the view's segments. When borrow is set, file-backed segments which are identical on disk point directly
+    // into a mapping of the original file instead of being copied.
+    // Borrowed bytes are only compared with the view when the snapshot is created. On Windows the file can't be written
+    // while it is mapped, elsewhere changes made to it afterwards show up in the snapshot, and truncating it makes
+    // reading the missing pages raise SIGBUS. Pass borrow = false for files which may change while they are open.
+    std::shared_ptr<view_data> create_view_data(Ref<BinaryView> view, bool borrow = true);
+
+    // Returns a snapshot of the view's bytes, shared between commands until the view is modified
+    std::shared_ptr<const view_data> get_view_data(Ref<BinaryView> view);
+
+    // Resolves patterns against a snapshot of the view, reading anything outside of it through the API
+    class binary_view_source
+        : public byte_source
     {
-        uint64_t start;
-        uint64_t length;
-        std::unique_ptr<uint8_t[ ]> data;
+    public:
+        explicit binary_view_source(Ref<BinaryView> view);
 
-        view_segment(Ref<BinaryView> view, uint64_t start, uint64_t length);
-    };
+        std::shared_ptr<const view_data> data() const override;
 
-    struct view_data
-    {
-        Ref<BinaryView> view;
-        std::vector<view_segment> segments;
-
-        view_data(Ref<BinaryView> view);
-
-        template <typename Scanner, typename UnaryPredicate>
-        void operator()(const Scanner& scanner, UnaryPredicate pred) const
-        {
-            for (const view_segment& segment : segments)
-            {
-                mem::region range { segment.data.get(), segment.length };
-
-                scanner(range, [&] (mem::pointer result)
-                {
-                    return pred(result.shift(range.start, segment.start).as<uint64_t>());
-                });
-            }
-        }
-
-        template <typename Scanner>
-        uint64_t scan(const Scanner& scanner) const
-        {
-            uint64_t result = 0;
-
-            (*this)(scanner, [&] (uint64_t addr) -> bool
-            {
-                result = addr;
-
-                return true;
-            });
-
-            return result;
-        }
-
-        template <typename Scanner>
-        std::vector<uint64_t> scan_all(const Scanner& scanner) const
-        {
-            std::vector<uint64_t> results;
-
-            (*this)(scanner, [&results] (uint64_t addr) -> bool
-            {
-                results.emplace_back(addr);
-
-                return false;
-            });
-
-            return results;
-        }
+        bool big_endian() const override;
+        size_t address_size() const override;
+
+        bool read(uint64_t address, void* buffer, size_t length) const override;
+
+    private:
+        Ref<BinaryView> view_;
+        std::shared_ptr<const view_data> data_;
+
+        bool big_endian_ {false};
+        size_t address_size_ {0};
     };
+
+    class suffix_index;
+
+    // Returns an index over the current snapshot of the view, building it if needed
+    std::shared_ptr<const suffix_index> get_suffix_index(Ref<BinaryView> view);
 }
@@ -0,0 +1,88 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "MappedFile.h"
+#include "ViewData.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace brick
+{
+    // An executable loaded from disk without Binary Ninja. ELF and PE files are mapped by their segments/sections,
+    // anything else is mapped as a single raw segment.
+    class image_source
+        : public byte_source
+    {
+    public:
+        enum class image_format
+        {
+            raw,
+            elf,
+            pe,
+        };
+
+        // Detects the format, mapping unknown or malformed files as raw at raw_base
+        bool open(const std::string& file_name, uint64_t raw_base = 0);
+        bool open_raw(const std::string& file_name, uint64_t base, size_t address_size = 8);
+
+        image_format format() const
+        {
+            return format_;
+        }
+
+        std::shared_ptr<const view_data> data() const override;
+
+        bool big_endian() const override;
+        size_t address_size() const override;
+
+        bool read(uint64_t address, void* buffer, size_t length) const override;
+
+    private:
+        bool map_file(const std::string& file_name);
+
+        bool load_elf();
+        bool load_pe();
+        void load_raw(uint64_t base);
+
+        // Segments are only recorded while the headers are parsed, and mapped once overlaps are removed
+        struct segment_range
+        {
+            uint64_t start;
+            uint64_t memory_size;
+            uint64_t file_offset;
+            uint64_t file_size;
+        };
+
+        bool add_segment(uint64_t start, uint64_t memory_size, uint64_t file_offset, uint64_t file_size);
+        bool map_segments();
+
+        std::shared_ptr<const mapped_file> mapping_;
+        std::shared_ptr<view_data> data_;
+
+        std::vector<segment_range> ranges_;
+
+        image_format format_ {image_format::raw};
+        bool big_endian_ {false};
+        size_t address_size_ {8};
+    };
+}
@@ -21,11 +21,218 @@
 
 #include <cstdint>
 
-#include <thread>
-#include <mutex>
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+inline size_t parallel_get_thread_count()
+{
+    size_t result = std::thread::hardware_concurrency();
+
+    if (!result)
+    {
+        result = 1;
+    }
+
+    return result;
+}
+
+// Process-wide work-stealing thread pool.
+// Every worker owns a deque, which it pushes to and pops from the back of, while idle threads steal from the front.
+// Threads waiting on tasks run other queued tasks instead of blocking, so parallel functions can safely be nested.
+class parallel_thread_pool
+{
+public:
+    using task = std::function<void()>;
+
+    static parallel_thread_pool& get()
+    {
+        // The calling thread also runs tasks while it waits
+        static parallel_thread_pool pool(std::max<size_t>(parallel_get_thread_count(), 2) - 1);
+
+        return pool;
+    }
+
+    explicit parallel_thread_pool(size_t worker_count)
+        : queues_(worker_count + 1)
+    {
+        workers_.reserve(worker_count);
+
+        for (size_t i = 0; i < worker_count; ++i)
+        {
+            workers_.emplace_back([this, i] { run(i); });
+        }
+    }
+
+    ~parallel_thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock_);
+
+            stopping_ = true;
+        }
+
+        sleep_cv_.notify_all();
+
+        for (std::thread& worker : workers_)
+        {
+            worker.join();
+        }
+    }
+
+    parallel_thread_pool(const parallel_thread_pool&) = delete;
+    parallel_thread_pool& operator=(const parallel_thread_pool&) = delete;
+
+    void push(task func)
+    {
+        size_t index = current_index();
+
+        // Tasks from threads outside the pool go into the shared queue
+        if (index == SIZE_MAX)
+        {
+            index = queues_.size() - 1;
+        }
+
+        pending_.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> guard(queues_[index].lock);
+
+            queues_[index].tasks.push_back(std::move(func));
+        }
+
+        notify();
+    }
+
+    // Runs queued tasks until done() returns true
+    template <typename Predicate>
+    void wait(const Predicate& done)
+    {
+        const size_t index = current_index();
+
+        while (!done())
+        {
+            if (run_one(index))
+            {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> guard(sleep_lock_);
+
+            sleep_cv_.wait(guard, [&] { return done() || (pending_.load(std::memory_order_relaxed) != 0); });
+        }
+    }
+
+    // Wakes any waiting threads, after queueing a task or when a waited on condition may have changed
+    void notify()
+    {
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock_);
+        }
+
+        sleep_cv_.notify_all();
+    }
+
+private:
+    struct task_queue
+    {
+        std::mutex lock;
+        std::deque<task> tasks;
+    };
+
+    std::vector<task_queue> queues_;
+    std::vector<std::thread> workers_;
+
+    std::atomic_size_t pending_ {0};
+
+    std::mutex sleep_lock_;
+    std::condition_variable sleep_cv_;
+    bool stopping_ {false};
+
+    static size_t& current_index()
+    {
+        static thread_local size_t index = SIZE_MAX;
+
+        return index;
+    }
+
+    bool pop(size_t index, task& func, bool steal)
+    {
+        task_queue& queue = queues_[index];
+
+        std::lock_guard<std::mutex> guard(queue.lock);
+
+        if (queue.tasks.empty())
+        {
+            return false;
+        }
+
+        if (steal)
+        {
+            func = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        else
+        {
+            func = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+
+        return true;
+    }
+
+    bool run_one(size_t index)
+    {
+        task func;
+
+        bool found = (index != SIZE_MAX) && pop(index, func, false);
+
+        for (size_t i = 1; !found && (i <= queues_.size()); ++i)
+        {
+            found = pop((index + i) % queues_.size(), func, true);
+        }
+
+        if (!found)
+        {
+            return false;
+        }
+
+        pending_.fetch_sub(1, std::memory_order_relaxed);
+
+        func();
+
+        return true;
+    }
+
+    void run(size_t index)
+    {
+        current_index() = index;
+
+        while (true)
+        {
+            if (run_one(index))
+            {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> guard(sleep_lock_);
+
+            sleep_cv_.wait(guard, [this] { return stopping_ || (pending_.load(std::memory_order_relaxed) != 0); });
+
+            if (stopping_)
+            {
+                break;
+            }
+        }
+    }
+};
+
 template <typename UnaryFunction, typename... Args>
 inline void parallel_invoke_n(size_t thread_count, const UnaryFunction& func, const Args&... args)
 {
@@ -41,41 +248,39 @@ inline void parallel_invoke_n(size_t thread_count, const UnaryFunction& func, co
         return;
     }
 
-    std::vector<std::thread> threads;
+    parallel_thread_pool& pool = parallel_thread_pool::get();
 
-    threads.reserve(thread_count);
+    std::atomic_size_t remaining {thread_count};
 
-    for (uint32_t i = 0; i < thread_count; ++i)
+    for (size_t i = 1; i < thread_count; ++i)
     {
-        threads.emplace_back(func, i, args...);
-    }
+        pool.push([&, i]
+        {
+            func(i, args...);
 
-    for (std::thread& thread : threads)
-    {
-        thread.join();
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                pool.notify();
+            }
+        });
     }
-}
 
-inline size_t parallel_get_thread_count()
-{
-    size_t result = std::thread::hardware_concurrency();
+    func(0, args...);
 
-    if (!result)
-    {
-        result = 1;
-    }
+    remaining.fetch_sub(1, std::memory_order_acq_rel);
 
-    return result;
+    pool.wait([&] { return remaining.load(std::memory_order_acquire) == 0; });
 }
 
 template <typename ForwardIt, typename UnaryPredicate>
-inline void parallel_for_each(ForwardIt first, ForwardIt last, const UnaryPredicate& func)
+inline void parallel_for_each(ForwardIt first, ForwardIt last, const UnaryPredicate& func, std::forward_iterator_tag)
 {
     std::mutex mutex;
+    std::atomic_bool stopped {false};
 
     return parallel_invoke_n(parallel_get_thread_count(), [&] (size_t /*thread_index*/)
     {
-        while (true)
+        while (!stopped.load(std::memory_order_relaxed))
         {
             std::unique_lock<std::mutex> guard(mutex);
 
@@ -87,6 +292,8 @@ inline void parallel_for_each(ForwardIt first, ForwardIt last, const UnaryPredic
 
                 if (!func(std::forward<decltype(value)>(value)))
                 {
+                    stopped.store(true, std::memory_order_relaxed);
+
                     break;
                 }
             }
@@ -98,6 +305,58 @@ inline void parallel_for_each(ForwardIt first, ForwardIt last, const UnaryPredic
     });
 }
 
+template <typename RandomIt, typename UnaryPredicate>
+inline void parallel_for_each(RandomIt first, RandomIt last, const UnaryPredicate& func, std::random_access_iterator_tag)
+{
+    const size_t total = static_cast<size_t>(last - first);
+    const size_t thread_count = std::min<size_t>(parallel_get_thread_count(), total);
+
+    std::atomic_size_t current {0};
+    std::atomic_bool stopped {false};
+
+    return parallel_invoke_n(thread_count, [&, total, thread_count] (size_t /*thread_index*/)
+    {
+        while (!stopped.load(std::memory_order_relaxed))
+        {
+            size_t start = current.load(std::memory_order_relaxed);
+            size_t count = 0;
+
+            // Hand out large ranges first, shrinking as the remaining work runs out to keep threads balanced
+            do
+            {
+                if (start >= total)
+                {
+                    return;
+                }
+
+                count = std::max<size_t>((total - start) / (thread_count * 4), 1);
+            } while (!current.compare_exchange_weak(start, start + count, std::memory_order_relaxed));
+
+            for (size_t i = start, end = start + count; i < end; ++i)
+            {
+                if (!func(first[i]))
+                {
+                    stopped.store(true, std::memory_order_relaxed);
+
+                    return;
+                }
+
+                if (stopped.load(std::memory_order_relaxed))
+                {
+                    return;
+                }
+            }
+        }
+    });
+}
+
+// Calls func on every element, stopping all threads once any call returns false
+template <typename ForwardIt, typename UnaryPredicate>
+inline void parallel_for_each(ForwardIt first, ForwardIt last, const UnaryPredicate& func)
+{
+    return parallel_for_each(first, last, func, typename std::iterator_traits<ForwardIt>::iterator_category());
+}
+
 template <typename UnaryPredicate>
 inline void parallel_partition(size_t total, size_t partition, size_t overlap, const UnaryPredicate& func)
 {
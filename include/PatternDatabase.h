@@ -0,0 +1,186 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "MappedFile.h"
+#include "StackMachine.h"
+
+#include <mem/pattern.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace brick
+{
+    // A precompiled pattern file, used in place without parsing or allocating anything per entry.
+    // Layout: header, one fixed size record per entry, string table, pattern bytes, pattern masks, linked ops code.
+    // Everything is stored in the native layout of a 64-bit little endian host.
+    class pattern_database
+    {
+    public:
+        enum entry_flags : uint32_t
+        {
+            flag_has_ops = 1 << 0,
+            flag_invalid_ops = 1 << 1,
+            flag_ops_error = 1 << 2,
+        };
+
+        struct entry
+        {
+            const char* name;
+            const char* category;
+            const char* pattern_string;
+            const char* ops_string;
+
+            const uint8_t* bytes;
+            const uint8_t* masks;
+            size_t size;
+
+            // Linked code, empty unless the ops were compiled successfully
+            const size_t* code;
+            size_t code_size;
+
+            uint32_t flags;
+
+            size_t count;
+            size_t index;
+        };
+
+        // Checks whether the file starts with the database magic
+        static bool is_database(const std::string& file_name);
+
+        bool open(const std::string& file_name);
+        bool open(std::vector<uint8_t> buffer);
+
+        size_t size() const
+        {
+            return records_ ? header_->entry_count : 0;
+        }
+
+        entry operator[](size_t index) const;
+
+        // The arrays every entry's bytes and masks point into
+        const uint8_t* pattern_bytes() const
+        {
+            return bytes_;
+        }
+
+        const uint8_t* pattern_masks() const
+        {
+            return masks_;
+        }
+
+    private:
+        friend class pattern_database_builder;
+
+        static constexpr char magic[8] {'B', 'R', 'K', 'P', 'A', 'T', 'D', 'B'};
+
+        // Bump whenever the layout or the stack machine encoding changes
+        static constexpr uint32_t version = 1;
+
+        struct file_header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t entry_count;
+
+            uint64_t records_offset;
+
+            uint64_t strings_offset;
+            uint64_t strings_size;
+
+            uint64_t bytes_offset;
+            uint64_t masks_offset;
+            uint64_t bytes_size;
+
+            // In 64-bit words
+            uint64_t code_offset;
+            uint64_t code_size;
+        };
+
+        struct file_record
+        {
+            uint32_t name;
+            uint32_t category;
+            uint32_t pattern_string;
+            uint32_t ops_string;
+
+            uint32_t pattern_offset;
+            uint32_t pattern_size;
+
+            uint32_t code_offset;
+            uint32_t code_size;
+
+            uint32_t flags;
+            uint32_t count;
+            uint32_t index;
+            uint32_t reserved;
+        };
+
+        bool load(const uint8_t* data, size_t size);
+
+        std::unique_ptr<mapped_file> mapping_;
+        std::vector<uint8_t> buffer_;
+
+        const file_header* header_ {nullptr};
+        const file_record* records_ {nullptr};
+        const char* strings_ {nullptr};
+        const uint8_t* bytes_ {nullptr};
+        const uint8_t* masks_ {nullptr};
+        const uint64_t* code_ {nullptr};
+    };
+
+    // Creates a pattern_database from parsed entries
+    class pattern_database_builder
+    {
+    public:
+        pattern_database_builder();
+
+        // program may be null if the entry has no ops, or they failed to compile.
+        // Returns false, without adding anything, if a value or the database would not fit the 32-bit record fields.
+        bool add(const std::string& name, const std::string& category, const std::string& pattern_string,
+            const mem::pattern& pattern, const std::string& ops_string, const mem::sm::program* program, uint32_t flags,
+            size_t count, size_t index);
+
+        size_t size() const
+        {
+            return records_.size();
+        }
+
+        std::vector<uint8_t> build() const;
+
+    private:
+        uint32_t add_string(const std::string& value);
+
+        std::vector<pattern_database::file_record> records_;
+
+        std::vector<char> strings_;
+        std::unordered_map<std::string, uint32_t> string_offsets_;
+
+        std::vector<uint8_t> bytes_;
+        std::vector<uint8_t> masks_;
+
+        std::vector<uint64_t> code_;
+        std::unordered_map<std::string, uint32_t> code_offsets_;
+    };
+}
@@ -22,3 +22,4 @@
 #include "BinaryNinja.h"
 
 void LoadPatternFile(Ref<BinaryView> view);
+void ConvertPatternFile(Ref<BinaryView> view);
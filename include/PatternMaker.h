@@ -21,4 +21,7 @@
 
 #include "BinaryNinja.h"
 
-void GenerateSignature(Ref<BinaryView> view, uint64_t addr);
\ No newline at end of file
+void GenerateSignature(Ref<BinaryView> view, uint64_t addr);
+void GenerateSignatures(Ref<BinaryView> view);
+void GenerateSelectionSignatures(Ref<BinaryView> view, uint64_t start, uint64_t length);
+void GenerateSymbolSignatures(Ref<BinaryView> view);
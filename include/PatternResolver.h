@@ -0,0 +1,91 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "PatternDatabase.h"
+#include "ViewData.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace brick
+{
+    enum class log_level
+    {
+        debug,
+        info,
+        warning,
+        error,
+    };
+
+    using log_function = std::function<void(log_level level, const std::string& message)>;
+
+    struct expression_stats
+    {
+        std::atomic_size_t hits {0};
+        std::atomic_size_t misses {0};
+        std::atomic<uint64_t> compile_us {0};
+    };
+
+    // Streams a YAML pattern file into the builder, without loading it as a document
+    bool parse_pattern_file(const std::string& file_name, pattern_database_builder& builder, expression_stats& stats,
+        const log_function& log);
+
+    // Opens a pattern database, or parses a whole YAML pattern file into one
+    bool load_pattern_file(const std::string& file_name, pattern_database& database, expression_stats& stats,
+        const log_function& log);
+
+    // The result of resolving one database entry
+    struct pattern_result
+    {
+        bool found {false};
+        uint64_t offset {0};
+    };
+
+    struct pattern_message
+    {
+        size_t entry;
+        log_level level;
+        std::string text;
+    };
+
+    struct resolve_results
+    {
+        // One per database entry
+        std::vector<pattern_result> entries;
+
+        // Entries are resolved in parallel, so messages are collected in one list and sorted into file order afterwards
+        std::vector<pattern_message> messages;
+    };
+
+    struct resolve_timings
+    {
+        std::chrono::steady_clock::duration scan {0};
+        std::chrono::steady_clock::duration evaluate {0};
+    };
+
+    // Scans for and evaluates every entry in the database, without allocating anything per entry
+    resolve_results resolve_patterns(const byte_source& source, const pattern_database& database,
+        resolve_timings* timings = nullptr);
+}
@@ -32,4 +32,47 @@ extern "C"
 
     BINARYNINJAPLUGIN size_t BinjaPattern_Scan(
         BinaryPattern* pattern, const uint8_t* data, size_t length, size_t* values, size_t limit);
+
+    // Scans a snapshot of every segment of the view on all threads, without copying it out of the plugin.
+    // Returns the matching addresses in ascending order, which must be freed with BinaryPattern_FreeAddresses.
+    BINARYNINJAPLUGIN uint64_t* BinaryPattern_ScanView(BinaryPattern* pattern, BNBinaryView* view, size_t* count);
+    BINARYNINJAPLUGIN void BinaryPattern_FreeAddresses(uint64_t* addresses);
+
+    // A scan which returns its matches in batches, resuming after the last match returned
+    struct BinaryPatternScan;
+
+    // The pattern and data must outlive the scan. Offsets are returned relative to data, plus base.
+    BINARYNINJAPLUGIN BinaryPatternScan* BinaryPattern_ScanBegin(
+        BinaryPattern* pattern, const uint8_t* data, size_t length, size_t base);
+
+    // Writes up to limit offsets in ascending order, returning 0 once there are no more matches
+    BINARYNINJAPLUGIN size_t BinaryPattern_ScanNext(BinaryPatternScan* scan, size_t* values, size_t limit);
+    BINARYNINJAPLUGIN void BinaryPattern_ScanEnd(BinaryPatternScan* scan);
+
+    // Receives a batch of offsets in ascending order, return true to stop scanning
+    typedef bool (*BinaryPatternCallback)(void* context, const size_t* values, size_t count);
+
+    // Passes every match to callback in batches of up to batch_size (at least 1), returning the number of matches passed.
+    // Offsets are relative to data, plus base.
+    BINARYNINJAPLUGIN size_t BinaryPattern_ScanCallback(BinaryPattern* pattern, const uint8_t* data, size_t length,
+        size_t base, BinaryPatternCallback callback, void* context, size_t batch_size);
+
+    // Many patterns compiled together, so a buffer is only scanned once for all of them
+    struct BinaryPatternSet;
+
+    struct BinaryPatternMatch
+    {
+        // Index of the pattern passed to BinaryPatternSet_Create
+        size_t Id;
+        size_t Offset;
+    };
+
+    // Empty or malformed patterns never match
+    BINARYNINJAPLUGIN BinaryPatternSet* BinaryPatternSet_Create(const char* const* patterns, size_t count);
+    BINARYNINJAPLUGIN void BinaryPatternSet_Free(BinaryPatternSet* set);
+
+    // Returns every match ordered by offset then id, which must be freed with BinaryPatternSet_FreeMatches
+    BINARYNINJAPLUGIN BinaryPatternMatch* BinaryPatternSet_Scan(
+        BinaryPatternSet* set, const uint8_t* data, size_t length, size_t* count);
+    BINARYNINJAPLUGIN void BinaryPatternSet_FreeMatches(BinaryPatternMatch* matches);
 }
@@ -0,0 +1,211 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <mem/mem.h>
+#include <mem/pattern.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace brick
+{
+    // Matches many patterns in a single pass.
+    // Every pattern is anchored on up to 4 literal bytes, which are looked up in a table at each position before the
+    // rest of the pattern is verified.
+    class pattern_set
+    {
+    public:
+        pattern_set() = default;
+
+        // Matches patterns stored in external byte and mask arrays, which must outlive the set, without copying them
+        pattern_set(const mem::byte* bytes, const mem::byte* masks);
+
+        size_t add(const mem::pattern& pattern);
+        size_t add(const mem::byte* bytes, const mem::byte* masks, size_t size);
+
+        // Adds the pattern at offset into the external arrays
+        size_t add_external(size_t offset, size_t size);
+
+        void reserve(size_t count);
+
+        void compile();
+
+        size_t size() const;
+        size_t max_pattern_size() const;
+
+        // pred(index, result) -> bool, return true to stop scanning
+        template <typename BinaryPredicate>
+        void operator()(mem::region range, BinaryPredicate pred) const;
+
+    private:
+        struct entry
+        {
+            size_t offset {0};
+            size_t size {0};
+
+            size_t anchor_offset {0};
+            size_t anchor_size {0};
+
+            uint32_t anchor_value {0};
+            uint32_t anchor_mask {0};
+        };
+
+        std::vector<mem::byte> bytes_;
+        std::vector<mem::byte> masks_;
+        std::vector<entry> entries_;
+
+        const mem::byte* external_bytes_ {nullptr};
+        const mem::byte* external_masks_ {nullptr};
+
+        size_t max_size_ {0};
+
+        uint32_t hash_shift_ {32};
+
+        std::vector<uint32_t> buckets4_;
+        std::vector<uint32_t> items4_;
+
+        std::vector<uint32_t> buckets2_;
+        std::vector<uint32_t> items2_;
+
+        std::vector<uint32_t> buckets1_;
+        std::vector<uint32_t> items1_;
+
+        std::vector<uint32_t> unanchored_;
+
+        static uint32_t load(const mem::byte* data, size_t length)
+        {
+            uint32_t result = 0;
+
+            switch (length < 4 ? length : 4)
+            {
+                case 4: result |= uint32_t(data[3]) << 24; // fallthrough
+                case 3: result |= uint32_t(data[2]) << 16; // fallthrough
+                case 2: result |= uint32_t(data[1]) << 8;  // fallthrough
+                case 1: result |= uint32_t(data[0]);
+            }
+
+            return result;
+        }
+
+        static uint32_t hash(uint32_t value, uint32_t shift)
+        {
+            return (value * 0x9E3779B1) >> shift;
+        }
+
+        size_t add_entry(size_t offset, size_t size, const mem::byte* bytes, const mem::byte* masks);
+
+        bool verify(const entry& e, const mem::byte* start, size_t length, size_t here, uint32_t value) const
+        {
+            if ((value & e.anchor_mask) != e.anchor_value)
+                return false;
+
+            if (here < e.anchor_offset)
+                return false;
+
+            const size_t offset = here - e.anchor_offset;
+
+            if (e.size > length - offset)
+                return false;
+
+            const mem::byte* data = start + offset;
+            const mem::byte* bytes = (external_bytes_ ? external_bytes_ : bytes_.data()) + e.offset;
+            const mem::byte* masks = (external_masks_ ? external_masks_ : masks_.data()) + e.offset;
+
+            for (size_t i = 0; i < e.size; ++i)
+            {
+                if ((data[i] ^ bytes[i]) & masks[i])
+                    return false;
+            }
+
+            return true;
+        }
+    };
+
+    template <typename BinaryPredicate>
+    inline void pattern_set::operator()(mem::region range, BinaryPredicate pred) const
+    {
+        const mem::byte* const start = range.start.as<const mem::byte*>();
+        const size_t length = range.size;
+
+        const bool has4 = !items4_.empty();
+        const bool has2 = !items2_.empty();
+        const bool has1 = !items1_.empty();
+        const bool has0 = !unanchored_.empty();
+
+        for (size_t here = 0; here < length; ++here)
+        {
+            const size_t avail = length - here;
+            const uint32_t value = load(start + here, avail);
+
+            const auto check = [&] (uint32_t index) -> bool
+            {
+                const entry& e = entries_[index];
+
+                if (!verify(e, start, length, here, value))
+                    return false;
+
+                return pred(size_t(index), mem::pointer(start + here - e.anchor_offset));
+            };
+
+            if (has4 && (avail >= 4))
+            {
+                const uint32_t bucket = hash(value, hash_shift_);
+
+                for (uint32_t i = buckets4_[bucket], end = buckets4_[bucket + 1]; i != end; ++i)
+                {
+                    if (check(items4_[i]))
+                        return;
+                }
+            }
+
+            if (has2 && (avail >= 2))
+            {
+                const uint32_t bucket = value & 0xFFFF;
+
+                for (uint32_t i = buckets2_[bucket], end = buckets2_[bucket + 1]; i != end; ++i)
+                {
+                    if (check(items2_[i]))
+                        return;
+                }
+            }
+
+            if (has1)
+            {
+                const uint32_t bucket = value & 0xFF;
+
+                for (uint32_t i = buckets1_[bucket], end = buckets1_[bucket + 1]; i != end; ++i)
+                {
+                    if (check(items1_[i]))
+                        return;
+                }
+            }
+
+            if (has0)
+            {
+                for (uint32_t index : unanchored_)
+                {
+                    if (check(index))
+                        return;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,114 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <mem/mem.h>
+#include <mem/pattern.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace brick
+{
+    // Number of occurrences of each byte value
+    using byte_histogram = std::array<uint64_t, 256>;
+
+    // Masked pattern scanner, used in place of mem::default_scanner.
+    // Two anchor bytes are compared at 32 (AVX2) or 16 (SSE2) positions at once, and only positions where both match
+    // are checked against the whole pattern. The implementation is picked at runtime, with a memchr based fallback.
+    // Given a histogram of the data being scanned, the rarest literal bytes are used as anchors.
+    class simd_scanner
+    {
+    public:
+        simd_scanner() = default;
+        explicit simd_scanner(const mem::pattern& pattern, const byte_histogram* histogram = nullptr);
+
+        // Implementations of the anchored search, the fastest one supported is used by default
+        enum class kernel
+        {
+            scalar,
+            sse2,
+            avx2,
+        };
+
+        // Switches to another implementation so they can be compared, returning false if it isn't supported.
+        // Patterns without any literal bytes don't use them, and are left as they are.
+        bool use_kernel(kernel value);
+
+        size_t size() const
+        {
+            return bytes_.size();
+        }
+
+        // Returns the first match in [start, end), or nullptr
+        const mem::byte* find(const mem::byte* start, const mem::byte* end) const
+        {
+            return find_ ? find_(*this, start, end) : nullptr;
+        }
+
+        // pred(result) -> bool, return true to stop scanning
+        template <typename UnaryPredicate>
+        void operator()(mem::region range, UnaryPredicate pred) const
+        {
+            const mem::byte* current = range.start.as<const mem::byte*>();
+            const mem::byte* const end = current + range.size;
+
+            while (const mem::byte* result = find(current, end))
+            {
+                if (pred(mem::pointer(result)))
+                    return;
+
+                current = result + 1;
+            }
+        }
+
+    private:
+        using find_function = const mem::byte* (*) (const simd_scanner&, const mem::byte*, const mem::byte*);
+
+        std::vector<mem::byte> bytes_;
+        std::vector<mem::byte> masks_;
+
+        // Offsets of the anchor bytes, which are never wildcards
+        size_t anchor1_ {0};
+        size_t anchor2_ {0};
+
+        find_function find_ {nullptr};
+
+        bool verify(const mem::byte* data) const
+        {
+            const mem::byte* bytes = bytes_.data();
+            const mem::byte* masks = masks_.data();
+
+            for (size_t i = 0, size = bytes_.size(); i < size; ++i)
+            {
+                if ((data[i] ^ bytes[i]) & masks[i])
+                    return false;
+            }
+
+            return true;
+        }
+
+        static const mem::byte* find_unanchored(const simd_scanner& scanner, const mem::byte* start, const mem::byte* end);
+        static const mem::byte* find_scalar(const simd_scanner& scanner, const mem::byte* start, const mem::byte* end);
+        static const mem::byte* find_sse2(const simd_scanner& scanner, const mem::byte* start, const mem::byte* end);
+        static const mem::byte* find_avx2(const simd_scanner& scanner, const mem::byte* start, const mem::byte* end);
+    };
+}
@@ -0,0 +1,201 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mem
+{
+    namespace sm
+    {
+        enum opcode : size_t
+        {
+            op_push,
+            op_add,
+            op_sub,
+            op_mul,
+            op_div,
+            op_mod,
+            op_and,
+            op_or,
+            op_xor,
+            op_neg,
+            op_sx,
+            op_dup,
+            op_drop,
+            op_load,
+            op_sym,
+
+            // Fused by link
+            op_sym_add,  // sym, value: push(sym + value)
+            op_load_rel, // size, bits: top += sx(load(top, size), bits), bits == 0 for no sign extension
+
+            // Internal
+            op_paren,
+
+            op_invalid = SIZE_MAX,
+        };
+
+        enum symbol : size_t
+        {
+            sym_here,
+        };
+
+        enum paren_type : size_t
+        {
+            paren_default,
+            paren_bracket,
+        };
+
+        bool compile_infix(const char* string, std::vector<size_t>& code);
+        bool compile_postfix(const char* string, std::vector<size_t>& code);
+
+        constexpr size_t max_stack_size = 16;
+
+        // Code which has been checked by link, and can be run without any bounds checks
+        struct program
+        {
+            std::vector<size_t> code;
+            size_t max_stack {0};
+        };
+
+        // Validates the code (operands, stack depth, exactly one result), folds constants and fuses common sequences
+        bool link(const std::vector<size_t>& code, program& out);
+
+        // Checks linked code (for example, loaded from a file) is safe to run
+        bool verify(const size_t* code, size_t length, size_t& max_stack);
+
+        // Environment must provide:
+        //   bool read_integer(size_t addr, size_t size, size_t& out) const
+        //   bool resolve_symbol(size_t sym, size_t& out) const
+        // The code must have passed link or verify
+        template <typename Environment>
+        inline bool run(const size_t* code, size_t length, const Environment& env, size_t& result)
+        {
+            size_t stack[max_stack_size];
+            size_t sp = 0;
+
+            const size_t* const end = code + length;
+
+            while (code != end)
+            {
+                switch (*code++)
+                {
+                    case op_push: stack[sp++] = *code++; break;
+                    case op_add: --sp; stack[sp - 1] += stack[sp]; break;
+                    case op_sub: --sp; stack[sp - 1] -= stack[sp]; break;
+                    case op_mul: --sp; stack[sp - 1] *= stack[sp]; break;
+                    case op_and: --sp; stack[sp - 1] &= stack[sp]; break;
+                    case op_or:  --sp; stack[sp - 1] |= stack[sp]; break;
+                    case op_xor: --sp; stack[sp - 1] ^= stack[sp]; break;
+                    case op_neg: stack[sp - 1] = size_t(0) - stack[sp - 1]; break;
+                    case op_dup: stack[sp] = stack[sp - 1]; ++sp; break;
+                    case op_drop: --sp; break;
+
+                    case op_div:
+                    {
+                        if (stack[--sp] == 0)
+                            return false;
+
+                        stack[sp - 1] /= stack[sp];
+                    } break;
+
+                    case op_mod:
+                    {
+                        if (stack[--sp] == 0)
+                            return false;
+
+                        stack[sp - 1] %= stack[sp];
+                    } break;
+
+                    case op_sx:
+                    {
+                        size_t mask = size_t(1) << (*code++ - 1);
+
+                        stack[sp - 1] = (stack[sp - 1] ^ mask) - mask;
+                    } break;
+
+                    case op_load:
+                    {
+                        size_t temp = SIZE_MAX;
+
+                        if (!env.read_integer(stack[sp - 1], *code++, temp))
+                            return false;
+
+                        stack[sp - 1] = temp;
+                    } break;
+
+                    case op_sym:
+                    {
+                        size_t temp = SIZE_MAX;
+
+                        if (!env.resolve_symbol(*code++, temp))
+                            return false;
+
+                        stack[sp++] = temp;
+                    } break;
+
+                    case op_sym_add:
+                    {
+                        size_t temp = SIZE_MAX;
+
+                        if (!env.resolve_symbol(code[0], temp))
+                            return false;
+
+                        stack[sp++] = temp + code[1];
+
+                        code += 2;
+                    } break;
+
+                    case op_load_rel:
+                    {
+                        size_t temp = SIZE_MAX;
+
+                        if (!env.read_integer(stack[sp - 1], code[0], temp))
+                            return false;
+
+                        if (code[1])
+                        {
+                            size_t mask = size_t(1) << (code[1] - 1);
+
+                            temp = (temp ^ mask) - mask;
+                        }
+
+                        stack[sp - 1] += temp;
+
+                        code += 2;
+                    } break;
+                }
+            }
+
+            result = stack[0];
+
+            return true;
+        }
+
+        template <typename Environment>
+        inline bool run(const program& prog, const Environment& env, size_t& result)
+        {
+            return run(prog.code.data(), prog.code.size(), env, result);
+        }
+    }
+}
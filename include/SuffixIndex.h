@@ -0,0 +1,53 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "ViewData.h"
+
+namespace brick
+{
+    // Suffix arrays over each segment of a view_data, used to count pattern matches without scanning every byte.
+    // Uses 4 bytes per byte of the view, and about twice that while it is being built.
+    class suffix_index
+    {
+    public:
+        explicit suffix_index(std::shared_ptr<const view_data> data);
+
+        const std::shared_ptr<const view_data>& data() const
+        {
+            return data_;
+        }
+
+        // Returns up to limit addresses where the pattern matches, in no particular order
+        std::vector<uint64_t> find(const mem::pattern& pattern, size_t limit = SIZE_MAX) const;
+
+    private:
+        struct segment_index
+        {
+            const view_segment* segment {nullptr};
+
+            // Empty if the segment is too large to index
+            std::vector<int32_t> suffixes;
+        };
+
+        std::shared_ptr<const view_data> data_;
+        std::vector<segment_index> segments_;
+    };
+}
@@ -0,0 +1,281 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <mem/mem.h>
+#include <mem/pattern.h>
+
+#include "MappedFile.h"
+#include "ParallelFunctions.h"
+#include "PatternSet.h"
+#include "SimdScanner.h"
+
+#include <memory>
+#include <mutex>
+
+namespace brick
+{
+    struct view_segment
+    {
+        uint64_t start;
+        uint64_t length;
+        const uint8_t* data;
+
+        // Only set when the segment owns a copy of its bytes
+        std::unique_ptr<uint8_t[ ]> buffer;
+
+        view_segment(uint64_t start, uint64_t length, const uint8_t* data);
+        view_segment(uint64_t start, uint64_t length, std::unique_ptr<uint8_t[ ]> buffer);
+    };
+
+    // Every match of a pattern_set, kept in one buffer grouped by pattern
+    struct pattern_set_results
+    {
+        // The matches of pattern i are addresses[offsets[i]] up to addresses[offsets[i + 1]], in ascending order
+        std::vector<size_t> offsets;
+        std::vector<uint64_t> addresses;
+
+        size_t count(size_t index) const
+        {
+            return offsets[index + 1] - offsets[index];
+        }
+
+        uint64_t* data(size_t index)
+        {
+            return addresses.data() + offsets[index];
+        }
+
+        const uint64_t* data(size_t index) const
+        {
+            return addresses.data() + offsets[index];
+        }
+    };
+
+    // A snapshot of the bytes of a view, with segments sorted by address
+    struct view_data
+    {
+        std::shared_ptr<const mapped_file> mapping;
+        std::vector<view_segment> segments;
+
+        // Returns the bytes at [address, address + length), if they are all within one segment
+        const uint8_t* find(uint64_t address, size_t length) const;
+
+        bool match(uint64_t address, const mem::pattern& pattern) const;
+
+        bool read(uint64_t address, void* buffer, size_t length) const;
+
+        // Counts every byte in the snapshot the first time it is called
+        const byte_histogram& histogram() const;
+
+        template <typename Scanner, typename UnaryPredicate>
+        void operator()(const Scanner& scanner, UnaryPredicate pred) const
+        {
+            for (const view_segment& segment : segments)
+            {
+                mem::region range { segment.data, segment.length };
+
+                scanner(range, [&] (mem::pointer result)
+                {
+                    return pred(result.shift(range.start, segment.start).as<uint64_t>());
+                });
+            }
+        }
+
+        // Segments are scanned in chunks of this size on all threads
+        static constexpr size_t scan_partition_size = 0x400000;
+
+        template <typename Scanner>
+        uint64_t scan(const Scanner& scanner, size_t pattern_size) const
+        {
+            for (const view_segment& segment : segments)
+            {
+                if (segment.length == 0)
+                    continue;
+
+                std::atomic_size_t first {SIZE_MAX};
+
+                parallel_partition(static_cast<size_t>(segment.length), scan_partition_size, pattern_size ? pattern_size - 1 : 0,
+                    [&] (size_t offset, size_t length) -> bool
+                {
+                    // Chunks are handed out in order, so every remaining chunk is past the best result
+                    if (offset >= first.load(std::memory_order_relaxed))
+                        return false;
+
+                    scanner(mem::region { segment.data + offset, length }, [&] (mem::pointer result) -> bool
+                    {
+                        const size_t result_offset = result.as<const uint8_t*>() - segment.data;
+
+                        // Results in the overlap belong to the next chunk
+                        if (result_offset - offset >= scan_partition_size)
+                            return true;
+
+                        size_t current = first.load(std::memory_order_relaxed);
+
+                        while ((result_offset < current) && !first.compare_exchange_weak(current, result_offset, std::memory_order_relaxed))
+                        { }
+
+                        return true;
+                    });
+
+                    return true;
+                });
+
+                if (first != SIZE_MAX)
+                {
+                    return segment.start + first;
+                }
+            }
+
+            return 0;
+        }
+
+        template <typename Scanner>
+        std::vector<uint64_t> scan_all(const Scanner& scanner, size_t pattern_size) const
+        {
+            std::vector<uint64_t> results;
+
+            for (const view_segment& segment : segments)
+            {
+                if (segment.length == 0)
+                    continue;
+
+                std::vector<std::vector<uint64_t>> chunk_results((segment.length + scan_partition_size - 1) / scan_partition_size);
+
+                parallel_partition(static_cast<size_t>(segment.length), scan_partition_size, pattern_size ? pattern_size - 1 : 0,
+                    [&] (size_t offset, size_t length) -> bool
+                {
+                    std::vector<uint64_t>& sub_results = chunk_results[offset / scan_partition_size];
+
+                    scanner(mem::region { segment.data + offset, length }, [&] (mem::pointer result) -> bool
+                    {
+                        const size_t result_offset = result.as<const uint8_t*>() - segment.data;
+
+                        if (result_offset - offset < scan_partition_size)
+                            sub_results.emplace_back(segment.start + result_offset);
+
+                        return false;
+                    });
+
+                    return true;
+                });
+
+                for (const std::vector<uint64_t>& sub_results : chunk_results)
+                {
+                    results.insert(results.end(), sub_results.begin(), sub_results.end());
+                }
+            }
+
+            return results;
+        }
+
+        template <typename BinaryPredicate>
+        void operator()(const pattern_set& patterns, BinaryPredicate pred) const
+        {
+            for (const view_segment& segment : segments)
+            {
+                mem::region range { segment.data, segment.length };
+
+                patterns(range, [&] (size_t index, mem::pointer result)
+                {
+                    return pred(index, result.shift(range.start, segment.start).as<uint64_t>());
+                });
+            }
+        }
+
+        pattern_set_results scan_all(const pattern_set& patterns) const
+        {
+            std::vector<std::pair<size_t, uint64_t>> matches;
+
+            const size_t overlap = patterns.max_pattern_size() ? patterns.max_pattern_size() - 1 : 0;
+
+            for (const view_segment& segment : segments)
+            {
+                if (segment.length == 0)
+                    continue;
+
+                std::vector<std::vector<std::pair<size_t, uint64_t>>> chunk_results(
+                    (segment.length + scan_partition_size - 1) / scan_partition_size);
+
+                parallel_partition(static_cast<size_t>(segment.length), scan_partition_size, overlap,
+                    [&] (size_t offset, size_t length) -> bool
+                {
+                    std::vector<std::pair<size_t, uint64_t>>& sub_results = chunk_results[offset / scan_partition_size];
+
+                    patterns(mem::region { segment.data + offset, length }, [&] (size_t index, mem::pointer result) -> bool
+                    {
+                        const size_t result_offset = result.as<const uint8_t*>() - segment.data;
+
+                        // Shorter patterns can match entirely within the overlap, which the next chunk also scans
+                        if (result_offset - offset < scan_partition_size)
+                            sub_results.emplace_back(index, segment.start + result_offset);
+
+                        return false;
+                    });
+
+                    return true;
+                });
+
+                for (const std::vector<std::pair<size_t, uint64_t>>& sub_results : chunk_results)
+                {
+                    matches.insert(matches.end(), sub_results.begin(), sub_results.end());
+                }
+            }
+
+            // Counting sort by pattern, which keeps each pattern's matches in address order
+            pattern_set_results results;
+
+            results.offsets.assign(patterns.size() + 1, 0);
+            results.addresses.resize(matches.size());
+
+            for (const std::pair<size_t, uint64_t>& match : matches)
+                ++results.offsets[match.first + 1];
+
+            for (size_t i = 0; i < patterns.size(); ++i)
+                results.offsets[i + 1] += results.offsets[i];
+
+            std::vector<size_t> cursors(results.offsets.begin(), results.offsets.end() - 1);
+
+            for (const std::pair<size_t, uint64_t>& match : matches)
+                results.addresses[cursors[match.first]++] = match.second;
+
+            return results;
+        }
+
+    private:
+        mutable std::once_flag histogram_once_;
+        mutable byte_histogram histogram_ {};
+    };
+
+    // Something patterns can be resolved against, such as a Binary Ninja view or an executable loaded from disk
+    class byte_source
+    {
+    public:
+        virtual ~byte_source() = default;
+
+        // The bytes which are scanned, shared with anything else using the source
+        virtual std::shared_ptr<const view_data> data() const = 0;
+
+        virtual bool big_endian() const = 0;
+        virtual size_t address_size() const = 0;
+
+        // Reads bytes which are not part of the snapshot
+        virtual bool read(uint64_t address, void* buffer, size_t length) const = 0;
+    };
+}
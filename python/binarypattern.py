@@ -1,3 +1,5 @@
+from array import array
+from contextlib import contextmanager
 from ctypes import *
 from os import path
 
@@ -18,6 +20,98 @@ _BinjaPattern_Scan = _binarypattern_dll['BinjaPattern_Scan']
 _BinjaPattern_Scan.argtypes = [POINTER(_BinaryPattern), POINTER(c_ubyte), c_size_t, POINTER(c_size_t), c_size_t]
 _BinjaPattern_Scan.restype = c_size_t
 
+_BinaryPattern_ScanView = _binarypattern_dll['BinaryPattern_ScanView']
+_BinaryPattern_ScanView.argtypes = [POINTER(_BinaryPattern), c_void_p, POINTER(c_size_t)]
+_BinaryPattern_ScanView.restype = POINTER(c_uint64)
+
+_BinaryPattern_FreeAddresses = _binarypattern_dll['BinaryPattern_FreeAddresses']
+_BinaryPattern_FreeAddresses.argtypes = [POINTER(c_uint64)]
+_BinaryPattern_FreeAddresses.restype = None
+
+class _BinaryPatternScan(Structure):
+    pass
+
+_BinaryPattern_ScanBegin = _binarypattern_dll['BinaryPattern_ScanBegin']
+_BinaryPattern_ScanBegin.argtypes = [POINTER(_BinaryPattern), POINTER(c_ubyte), c_size_t, c_size_t]
+_BinaryPattern_ScanBegin.restype = POINTER(_BinaryPatternScan)
+
+_BinaryPattern_ScanNext = _binarypattern_dll['BinaryPattern_ScanNext']
+_BinaryPattern_ScanNext.argtypes = [POINTER(_BinaryPatternScan), POINTER(c_size_t), c_size_t]
+_BinaryPattern_ScanNext.restype = c_size_t
+
+_BinaryPattern_ScanEnd = _binarypattern_dll['BinaryPattern_ScanEnd']
+_BinaryPattern_ScanEnd.argtypes = [POINTER(_BinaryPatternScan)]
+_BinaryPattern_ScanEnd.restype = None
+
+_BinaryPatternCallback = CFUNCTYPE(c_bool, c_void_p, POINTER(c_size_t), c_size_t)
+
+_BinaryPattern_ScanCallback = _binarypattern_dll['BinaryPattern_ScanCallback']
+_BinaryPattern_ScanCallback.argtypes = [POINTER(_BinaryPattern), POINTER(c_ubyte), c_size_t, c_size_t, _BinaryPatternCallback, c_void_p, c_size_t]
+_BinaryPattern_ScanCallback.restype = c_size_t
+
+class _BinaryPatternSet(Structure):
+    pass
+
+class _BinaryPatternMatch(Structure):
+    _fields_ = [('Id', c_size_t), ('Offset', c_size_t)]
+
+_BinaryPatternSet_Create = _binarypattern_dll['BinaryPatternSet_Create']
+_BinaryPatternSet_Create.argtypes = [POINTER(c_char_p), c_size_t]
+_BinaryPatternSet_Create.restype = POINTER(_BinaryPatternSet)
+
+_BinaryPatternSet_Free = _binarypattern_dll['BinaryPatternSet_Free']
+_BinaryPatternSet_Free.argtypes = [POINTER(_BinaryPatternSet)]
+_BinaryPatternSet_Free.restype = None
+
+_BinaryPatternSet_Scan = _binarypattern_dll['BinaryPatternSet_Scan']
+_BinaryPatternSet_Scan.argtypes = [POINTER(_BinaryPatternSet), POINTER(c_ubyte), c_size_t, POINTER(c_size_t)]
+_BinaryPatternSet_Scan.restype = POINTER(_BinaryPatternMatch)
+
+_BinaryPatternSet_FreeMatches = _binarypattern_dll['BinaryPatternSet_FreeMatches']
+_BinaryPatternSet_FreeMatches.argtypes = [POINTER(_BinaryPatternMatch)]
+_BinaryPatternSet_FreeMatches.restype = None
+
+class _Py_buffer(Structure):
+    _fields_ = [
+        ('buf', c_void_p),
+        ('obj', c_void_p),
+        ('len', c_ssize_t),
+        ('itemsize', c_ssize_t),
+        ('readonly', c_int),
+        ('ndim', c_int),
+        ('format', c_char_p),
+        ('shape', POINTER(c_ssize_t)),
+        ('strides', POINTER(c_ssize_t)),
+        ('suboffsets', POINTER(c_ssize_t)),
+        ('internal', c_void_p)]
+
+# pythonapi raises any exception set by the call, such as a BufferError for non-contiguous data
+_PyObject_GetBuffer = pythonapi.PyObject_GetBuffer
+_PyObject_GetBuffer.argtypes = [py_object, POINTER(_Py_buffer), c_int]
+_PyObject_GetBuffer.restype = c_int
+
+_PyBuffer_Release = pythonapi.PyBuffer_Release
+_PyBuffer_Release.argtypes = [POINTER(_Py_buffer)]
+_PyBuffer_Release.restype = None
+
+_PyBUF_SIMPLE = 0
+
+@contextmanager
+def _borrow_buffer(data, start, end):
+    """Borrows [start, end) of any contiguous buffer protocol object (bytes, bytearray, memoryview, mmap, numpy arrays, ...) without copying it.
+    Yields a pointer to data[start], the length and start (as a non-negative offset). The pointer is only valid until the context exits."""
+    view = _Py_buffer()
+
+    _PyObject_GetBuffer(data, byref(view), _PyBUF_SIMPLE)
+
+    try:
+        start, end, _ = slice(start, end).indices(view.len)
+        end = max(start, end)
+
+        yield cast((view.buf or 0) + start, POINTER(c_ubyte)), c_size_t(end - start), start
+    finally:
+        _PyBuffer_Release(byref(view))
+
 class BinaryPattern:
     def __init__(self, pattern):
         self.handle = _BinaryPattern_Parse(create_string_buffer(pattern.encode('ascii')))
@@ -25,10 +119,88 @@ class BinaryPattern:
     def __del__(self):
         _BinaryPattern_Free(self.handle)
 
-    def find(self, data):
+    def find(self, data, start=0, end=None):
+        """Returns the offset of the first match in data[start:end], or None"""
         result = c_size_t()
 
-        if _BinjaPattern_Scan(self.handle, cast(data, POINTER(c_ubyte)), c_size_t(len(data)), cast(addressof(result), POINTER(c_size_t)), c_size_t(1)):
-            return result.value
-        else:
-            return None
+        with _borrow_buffer(data, start, end) as (pointer, length, start):
+            if _BinjaPattern_Scan(self.handle, pointer, length, byref(result), c_size_t(1)):
+                return start + result.value
+
+        return None
+
+    def find_in_view(self, view):
+        """Returns the address of every match in a binaryninja.BinaryView, in ascending order.
+        The view is scanned natively on all threads, and CDLL calls release the GIL, so other Python threads keep running."""
+        count = c_size_t()
+        addresses = _BinaryPattern_ScanView(self.handle, cast(view.handle, c_void_p), byref(count))
+
+        try:
+            return addresses[:count.value]
+        finally:
+            _BinaryPattern_FreeAddresses(addresses)
+
+    def find_all(self, data, start=0, end=None, batch_size=65536):
+        """Returns the offset of every match in data[start:end] as an array('Q'), in ascending order"""
+        result = array('Q')
+
+        for values, count in self._scan_batches(data, start, end, batch_size):
+            result.frombytes(memoryview(values).cast('B')[:count * sizeof(c_size_t)])
+
+        return result
+
+    def finditer(self, data, start=0, end=None, batch_size=4096):
+        """Yields the offset of every match in data[start:end], in ascending order, scanning it only once"""
+        for values, count in self._scan_batches(data, start, end, batch_size):
+            for offset in values[:count]:
+                yield offset
+
+    def scan(self, data, callback, batch_size=4096, start=0, end=None):
+        """Calls callback with each batch of match offsets, stopping early if it returns True. Returns the number of matches passed."""
+        with _borrow_buffer(data, start, end) as (pointer, length, start):
+            def on_batch(context, values, count):
+                return bool(callback(values[:count]))
+
+            return _BinaryPattern_ScanCallback(self.handle, pointer, length, c_size_t(start), _BinaryPatternCallback(on_batch), None, c_size_t(batch_size))
+
+    def _scan_batches(self, data, start, end, batch_size):
+        """Yields the batch buffer and how many offsets it holds, which the scan adds start to natively"""
+        values = (c_size_t * batch_size)()
+
+        with _borrow_buffer(data, start, end) as (pointer, length, start):
+            scan = _BinaryPattern_ScanBegin(self.handle, pointer, length, c_size_t(start))
+
+            try:
+                while True:
+                    count = _BinaryPattern_ScanNext(scan, values, c_size_t(batch_size))
+
+                    if not count:
+                        break
+
+                    yield values, count
+            finally:
+                _BinaryPattern_ScanEnd(scan)
+
+class BinaryPatternSet:
+    """Many patterns compiled once, and found with a single pass over the data"""
+    def __init__(self, patterns):
+        self.patterns = list(patterns)
+
+        strings = (c_char_p * len(self.patterns))(*[pattern.encode('ascii') for pattern in self.patterns])
+
+        self.handle = _BinaryPatternSet_Create(strings, c_size_t(len(self.patterns)))
+
+    def __del__(self):
+        _BinaryPatternSet_Free(self.handle)
+
+    def scan(self, data, start=0, end=None):
+        """Returns a list of (pattern index, offset) for every match in data[start:end], ordered by offset"""
+        count = c_size_t()
+
+        with _borrow_buffer(data, start, end) as (pointer, length, start):
+            matches = _BinaryPatternSet_Scan(self.handle, pointer, length, byref(count))
+
+        try:
+            return [(matches[i].Id, start + matches[i].Offset) for i in range(count.value)]
+        finally:
+            _BinaryPatternSet_FreeMatches(matches)
@@ -19,38 +19,516 @@
 
 #include "BinaryNinja.h"
 #include "ParallelFunctions.h"
+#include "SuffixIndex.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
 
 namespace brick
 {
-    view_segment::view_segment(Ref<BinaryView> view, uint64_t start_, uint64_t length_)
-        : start(start_)
-        , length(length_)
-        , data(new uint8_t[length_])
+    static bool EndsWith(const std::string& value, const std::string& suffix)
+    {
+        return (value.size() >= suffix.size()) && !value.compare(value.size() - suffix.size(), suffix.size(), suffix);
+    }
+
+    static std::shared_ptr<const mapped_file> MapBackingFile(Ref<BinaryView> view)
     {
-        if (view->Read(data.get(), start, length) != length)
+        Ref<BinaryView> raw = view->GetParentView();
+
+        if (!raw || raw->IsModified())
+        {
+            return nullptr;
+        }
+
+        std::string file_name = view->GetFile()->GetFilename();
+
+        if (file_name.empty() || EndsWith(file_name, ".bndb"))
+        {
+            return nullptr;
+        }
+
+        std::shared_ptr<mapped_file> mapping = std::make_shared<mapped_file>();
+
+        if (!mapping->open(file_name) || (mapping->size() != raw->GetLength()))
+        {
+            return nullptr;
+        }
+
+        return mapping;
+    }
+
+    // Compares the whole range, since a file changed on disk (or a raw view patched anywhere) must never be borrowed
+    static bool MatchesView(Ref<BinaryView> view, uint64_t start, const uint8_t* data, uint64_t length)
+    {
+        constexpr size_t chunk_size = 0x100000;
+
+        std::atomic<bool> matches {true};
+
+        parallel_partition(static_cast<size_t>(length), chunk_size, 0, [&] (size_t offset, size_t size) -> bool
+        {
+            if (!matches.load(std::memory_order_relaxed))
+            {
+                return false;
+            }
+
+            std::unique_ptr<uint8_t[ ]> buffer(new uint8_t[size]);
+
+            if ((view->Read(buffer.get(), start + offset, size) != size) || std::memcmp(buffer.get(), data + offset, size))
+            {
+                matches = false;
+
+                return false;
+            }
+
+            return true;
+        });
+
+        return matches;
+    }
+
+    static const uint8_t* BorrowSegment(Ref<BinaryView> view, const mapped_file& mapping, Ref<Segment> segment)
+    {
+        const uint64_t start = segment->GetStart();
+        const uint64_t length = segment->GetLength();
+        const uint64_t offset = segment->GetDataOffset();
+
+        // Zero filled (e.g .bss) or truncated segments have no contiguous backing bytes
+        if ((length == 0) || (segment->GetDataLength() != length))
+        {
+            return nullptr;
+        }
+
+        if ((offset > mapping.size()) || (length > mapping.size() - offset))
+        {
+            return nullptr;
+        }
+
+        if (!view->GetRelocationRangesInRange(start, length).empty())
+        {
+            return nullptr;
+        }
+
+        const uint8_t* data = mapping.data() + offset;
+
+        // Checked once per snapshot, this only reads through a small buffer instead of keeping a second copy
+        if (!MatchesView(view, start, data, length))
+        {
+            return nullptr;
+        }
+
+        return data;
+    }
+
+    static view_segment CopySegment(Ref<BinaryView> view, uint64_t start, uint64_t length)
+    {
+        std::unique_ptr<uint8_t[ ]> buffer(new uint8_t[length]);
+
+        if (view->Read(buffer.get(), start, length) != length)
         {
             // TODO: Handle Errors
         }
+
+        return view_segment(start, length, std::move(buffer));
     }
 
-    view_data::view_data(Ref<BinaryView> view_)
-        : view(view_)
+    std::shared_ptr<view_data> create_view_data(Ref<BinaryView> view, bool borrow)
     {
+        std::shared_ptr<view_data> result = std::make_shared<view_data>();
+
+        std::vector<view_segment>& segments = result->segments;
         std::vector<Ref<Segment>> view_segments = view->GetSegments();
 
         if (!view_segments.empty())
         {
+            if (borrow)
+            {
+                result->mapping = MapBackingFile(view);
+            }
+
+            const mapped_file* mapping = result->mapping.get();
+
             segments.reserve(view_segments.size());
 
             for (const Ref<Segment>& segment : view_segments)
             {
-                segments.emplace_back(view, segment->GetStart(), segment->GetLength());
+                const uint8_t* data = mapping ? BorrowSegment(view, *mapping, segment) : nullptr;
+
+                if (data)
+                {
+                    segments.emplace_back(segment->GetStart(), segment->GetLength(), data);
+                }
+                else
+                {
+                    segments.push_back(CopySegment(view, segment->GetStart(), segment->GetLength()));
+                }
             }
         }
         else
         {
-            segments.emplace_back(view, view->GetStart(), view->GetLength());
+            segments.push_back(CopySegment(view, view->GetStart(), view->GetLength()));
         }
+
+        return result;
     }
-}
 
+    class view_data_cache
+    {
+    public:
+        view_data_cache();
+        ~view_data_cache();
+
+        std::shared_ptr<const view_data> get(Ref<BinaryView> view);
+        std::shared_ptr<const suffix_index> get_index(Ref<BinaryView> view);
+
+        void invalidate(BNBinaryView* view);
+
+    private:
+        class invalidator
+            : public BinaryDataNotification
+        {
+        public:
+            invalidator(view_data_cache& cache)
+                : cache_(cache)
+            { }
+
+            void OnBinaryDataWritten(BinaryView* view, uint64_t, size_t) override
+            {
+                cache_.invalidate(view->GetObject());
+            }
+
+            void OnBinaryDataInserted(BinaryView* view, uint64_t, size_t) override
+            {
+                cache_.invalidate(view->GetObject());
+            }
+
+            void OnBinaryDataRemoved(BinaryView* view, uint64_t, uint64_t) override
+            {
+                cache_.invalidate(view->GetObject());
+            }
+
+            void OnSegmentAdded(BinaryView* view, Segment*) override
+            {
+                cache_.invalidate(view->GetObject());
+            }
+
+            void OnSegmentRemoved(BinaryView* view, Segment*) override
+            {
+                cache_.invalidate(view->GetObject());
+            }
+
+            void OnSegmentUpdated(BinaryView* view, Segment*) override
+            {
+                cache_.invalidate(view->GetObject());
+            }
+
+        private:
+            view_data_cache& cache_;
+        };
+
+        // Drops the entries of views as they are destroyed, so the cache never keeps a closed view or its bytes alive
+        class destruction_listener
+            : public ObjectDestructionNotification
+        {
+        public:
+            destruction_listener(view_data_cache& cache)
+                : cache_(cache)
+            { }
+
+            void DestructBinaryView(BinaryView* view) override
+            {
+                cache_.remove(view);
+            }
+
+        private:
+            view_data_cache& cache_;
+        };
+
+        struct entry
+        {
+            // Not a reference, the entry is removed when the view is destroyed
+            BNBinaryView* view {nullptr};
+
+            std::shared_ptr<const view_data> data;
+            std::shared_ptr<const suffix_index> index;
+            std::unique_ptr<invalidator> notification;
+
+            // Unique across every entry, so a read which started before the entry was invalidated or replaced is
+            // never stored
+            uint64_t generation {0};
+        };
+
+        // Only the most recently used few views keep their snapshot
+        static constexpr size_t max_snapshots = 4;
+
+        std::mutex lock_;
+        std::vector<entry> entries_;
+        uint64_t next_generation_ {0};
+
+        destruction_listener listener_;
+
+        // Moves the view's entry to the front, dropping the snapshots of the least recently used views
+        entry* touch(BNBinaryView* view);
+
+        void remove(BinaryView* view);
+
+        // Unregisters the notifications of entries which have already been taken out of the cache
+        static void release(std::vector<entry>& removed, BinaryView* view);
+    };
+
+    view_data_cache::view_data_cache()
+        : listener_(*this)
+    { }
+
+    // Every view is normally destroyed (and removed) before the core shuts down, leaving nothing to unregister here
+    view_data_cache::~view_data_cache()
+    {
+        std::vector<entry> removed;
+
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+
+            removed.swap(entries_);
+        }
+
+        release(removed, nullptr);
+    }
+
+    view_data_cache::entry* view_data_cache::touch(BNBinaryView* view)
+    {
+        auto iter = std::find_if(entries_.begin(), entries_.end(), [&] (const entry& e)
+        {
+            return e.view == view;
+        });
+
+        if (iter == entries_.end())
+        {
+            return nullptr;
+        }
+
+        std::rotate(entries_.begin(), iter, iter + 1);
+
+        for (size_t i = max_snapshots; i < entries_.size(); ++i)
+        {
+            entries_[i].data.reset();
+            entries_[i].index.reset();
+        }
+
+        return &entries_.front();
+    }
+
+    std::shared_ptr<const view_data> view_data_cache::get(Ref<BinaryView> view)
+    {
+        BNBinaryView* handle = view->GetObject();
+
+        std::unique_ptr<invalidator> notification;
+        std::shared_ptr<const view_data> data;
+        uint64_t generation = 0;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> guard(lock_);
+
+                entry* e = touch(handle);
+
+                if (!e && notification)
+                {
+                    entry added;
+
+                    added.view = handle;
+                    added.notification = std::move(notification);
+                    added.generation = ++next_generation_;
+
+                    entries_.push_back(std::move(added));
+
+                    e = touch(handle);
+                }
+
+                if (e)
+                {
+                    data = e->data;
+                    generation = e->generation;
+
+                    break;
+                }
+            }
+
+            // Registered without holding lock_, a notification being delivered may be waiting for it in invalidate()
+            notification.reset(new invalidator(*this));
+
+            view->RegisterNotification(notification.get());
+        }
+
+        // Another thread added the view first
+        if (notification)
+        {
+            view->UnregisterNotification(notification.get());
+        }
+
+        if (data)
+        {
+            return data;
+        }
+
+        // Read the view without holding the lock, writes during the read will change the generation
+        data = create_view_data(view);
+
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+
+            for (entry& e : entries_)
+            {
+                if ((e.view == handle) && (e.generation == generation))
+                {
+                    e.data = data;
+
+                    break;
+                }
+            }
+        }
+
+        return data;
+    }
+
+    std::shared_ptr<const suffix_index> view_data_cache::get_index(Ref<BinaryView> view)
+    {
+        std::shared_ptr<const view_data> data = get(view);
+
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+
+            for (const entry& e : entries_)
+            {
+                if ((e.data == data) && e.index)
+                {
+                    return e.index;
+                }
+            }
+        }
+
+        std::shared_ptr<const suffix_index> index = std::make_shared<suffix_index>(data);
+
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+
+            for (entry& e : entries_)
+            {
+                if (e.data == data)
+                {
+                    e.index = index;
+
+                    break;
+                }
+            }
+        }
+
+        return index;
+    }
+
+    void view_data_cache::invalidate(BNBinaryView* view)
+    {
+        std::unique_lock<std::mutex> guard(lock_);
+
+        for (entry& e : entries_)
+        {
+            if (e.view == view)
+            {
+                e.data.reset();
+                e.index.reset();
+                e.generation = ++next_generation_;
+            }
+        }
+    }
+
+    void view_data_cache::remove(BinaryView* view)
+    {
+        std::vector<entry> removed;
+
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+
+            for (auto iter = entries_.begin(); iter != entries_.end();)
+            {
+                if (iter->view == view->GetObject())
+                {
+                    removed.push_back(std::move(*iter));
+
+                    iter = entries_.erase(iter);
+                }
+                else
+                {
+                    ++iter;
+                }
+            }
+        }
+
+        release(removed, view);
+    }
+
+    void view_data_cache::release(std::vector<entry>& removed, BinaryView* view)
+    {
+        // Called without holding lock_, a notification blocked in invalidate() can still finish before it is freed
+        for (entry& e : removed)
+        {
+            if (view)
+            {
+                view->UnregisterNotification(e.notification.get());
+            }
+            else
+            {
+                // Entries are removed as their views are destroyed, so the handle is still valid
+                Ref<BinaryView> target = new BinaryView(BNNewViewReference(e.view));
+
+                target->UnregisterNotification(e.notification.get());
+            }
+        }
+
+        removed.clear();
+    }
+
+    static view_data_cache& get_view_data_cache()
+    {
+        static view_data_cache cache;
+
+        return cache;
+    }
+
+    std::shared_ptr<const view_data> get_view_data(Ref<BinaryView> view)
+    {
+        return get_view_data_cache().get(view);
+    }
+
+    std::shared_ptr<const suffix_index> get_suffix_index(Ref<BinaryView> view)
+    {
+        return get_view_data_cache().get_index(view);
+    }
+
+    binary_view_source::binary_view_source(Ref<BinaryView> view)
+        : view_(view)
+        , data_(get_view_data(view))
+        , big_endian_(view->GetDefaultEndianness() == BigEndian)
+        , address_size_(view->GetAddressSize())
+    { }
+
+    std::shared_ptr<const view_data> binary_view_source::data() const
+    {
+        return data_;
+    }
+
+    bool binary_view_source::big_endian() const
+    {
+        return big_endian_;
+    }
+
+    size_t binary_view_source::address_size() const
+    {
+        return address_size_;
+    }
+
+    bool binary_view_source::read(uint64_t address, void* buffer, size_t length) const
+    {
+        return view_->Read(buffer, address, length) == length;
+    }
+}
@@ -0,0 +1,405 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ImageSource.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace brick
+{
+    // Segments are zero filled past their file data, so limit how much memory a malformed header can allocate
+    static constexpr uint64_t max_segment_size = uint64_t(1) << 32;
+    static constexpr uint64_t max_copied_size = uint64_t(1) << 32;
+
+    static bool ReadInteger(const mapped_file& file, uint64_t offset, size_t size, bool big_endian, uint64_t& out)
+    {
+        if ((offset > file.size()) || (size > file.size() - offset))
+        {
+            return false;
+        }
+
+        const uint8_t* data = file.data() + offset;
+
+        uint64_t result = 0;
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            result |= uint64_t(data[big_endian ? (size - i - 1) : i]) << (i * 8);
+        }
+
+        out = result;
+
+        return true;
+    }
+
+    bool image_source::open(const std::string& file_name, uint64_t raw_base)
+    {
+        if (!map_file(file_name))
+        {
+            return false;
+        }
+
+        const uint8_t* data = mapping_->data();
+        const size_t size = mapping_->size();
+
+        if ((size >= 4) && !std::memcmp(data, "\x7F" "ELF", 4) && load_elf())
+        {
+            return true;
+        }
+
+        if ((size >= 2) && !std::memcmp(data, "MZ", 2) && load_pe())
+        {
+            return true;
+        }
+
+        // Plenty of raw data starts with "MZ", and truncated or malformed images are still worth scanning
+        big_endian_ = false;
+        address_size_ = 8;
+
+        load_raw(raw_base);
+
+        return true;
+    }
+
+    bool image_source::open_raw(const std::string& file_name, uint64_t base, size_t address_size)
+    {
+        if (!map_file(file_name))
+        {
+            return false;
+        }
+
+        address_size_ = address_size;
+
+        load_raw(base);
+
+        return true;
+    }
+
+    std::shared_ptr<const view_data> image_source::data() const
+    {
+        return data_;
+    }
+
+    bool image_source::big_endian() const
+    {
+        return big_endian_;
+    }
+
+    size_t image_source::address_size() const
+    {
+        return address_size_;
+    }
+
+    bool image_source::read(uint64_t, void*, size_t) const
+    {
+        // Everything which is mapped is part of the snapshot
+        return false;
+    }
+
+    bool image_source::map_file(const std::string& file_name)
+    {
+        std::shared_ptr<mapped_file> mapping = std::make_shared<mapped_file>();
+
+        if (!mapping->open(file_name))
+        {
+            return false;
+        }
+
+        mapping_ = mapping;
+
+        data_ = std::make_shared<view_data>();
+        data_->mapping = mapping_;
+        ranges_.clear();
+
+        format_ = image_format::raw;
+        big_endian_ = false;
+        address_size_ = 8;
+
+        return true;
+    }
+
+    bool image_source::load_elf()
+    {
+        const mapped_file& file = *mapping_;
+
+        if (file.size() < 0x34)
+        {
+            return false;
+        }
+
+        const uint8_t elf_class = file.data()[4];
+        const uint8_t elf_data = file.data()[5];
+
+        if (((elf_class != 1) && (elf_class != 2)) || ((elf_data != 1) && (elf_data != 2)))
+        {
+            return false;
+        }
+
+        const bool is_64 = elf_class == 2;
+
+        format_ = image_format::elf;
+        big_endian_ = elf_data == 2;
+        address_size_ = is_64 ? 8 : 4;
+
+        const size_t word = address_size_;
+
+        uint64_t ph_offset = 0;
+        uint64_t ph_entry_size = 0;
+        uint64_t ph_count = 0;
+
+        if (!ReadInteger(file, is_64 ? 0x20 : 0x1C, word, big_endian_, ph_offset) ||
+            !ReadInteger(file, is_64 ? 0x36 : 0x2A, 2, big_endian_, ph_entry_size) ||
+            !ReadInteger(file, is_64 ? 0x38 : 0x2C, 2, big_endian_, ph_count))
+        {
+            return false;
+        }
+
+        if (ph_entry_size < (is_64 ? 0x38 : 0x20))
+        {
+            return false;
+        }
+
+        for (uint64_t i = 0; i < ph_count; ++i)
+        {
+            const uint64_t header = ph_offset + (i * ph_entry_size);
+
+            uint64_t type = 0;
+            uint64_t offset = 0;
+            uint64_t address = 0;
+            uint64_t file_size = 0;
+            uint64_t memory_size = 0;
+
+            if (!ReadInteger(file, header, 4, big_endian_, type) ||
+                !ReadInteger(file, header + (is_64 ? 0x08 : 0x04), word, big_endian_, offset) ||
+                !ReadInteger(file, header + (is_64 ? 0x10 : 0x08), word, big_endian_, address) ||
+                !ReadInteger(file, header + (is_64 ? 0x20 : 0x10), word, big_endian_, file_size) ||
+                !ReadInteger(file, header + (is_64 ? 0x28 : 0x14), word, big_endian_, memory_size))
+            {
+                return false;
+            }
+
+            // PT_LOAD
+            if (type != 1)
+            {
+                continue;
+            }
+
+            if (!add_segment(address, memory_size, offset, file_size))
+            {
+                return false;
+            }
+        }
+
+        return map_segments();
+    }
+
+    bool image_source::load_pe()
+    {
+        const mapped_file& file = *mapping_;
+
+        uint64_t pe_offset = 0;
+
+        if (!ReadInteger(file, 0x3C, 4, false, pe_offset))
+        {
+            return false;
+        }
+
+        uint64_t signature = 0;
+
+        if (!ReadInteger(file, pe_offset, 4, false, signature) || (signature != 0x4550))
+        {
+            return false;
+        }
+
+        const uint64_t coff_header = pe_offset + 4;
+        const uint64_t optional_header = coff_header + 20;
+
+        uint64_t section_count = 0;
+        uint64_t optional_header_size = 0;
+        uint64_t magic = 0;
+
+        if (!ReadInteger(file, coff_header + 2, 2, false, section_count) ||
+            !ReadInteger(file, coff_header + 16, 2, false, optional_header_size) ||
+            !ReadInteger(file, optional_header, 2, false, magic))
+        {
+            return false;
+        }
+
+        // PE32 or PE32+
+        if ((magic != 0x10B) && (magic != 0x20B))
+        {
+            return false;
+        }
+
+        const bool is_64 = magic == 0x20B;
+
+        format_ = image_format::pe;
+        big_endian_ = false;
+        address_size_ = is_64 ? 8 : 4;
+
+        uint64_t image_base = 0;
+        uint64_t headers_size = 0;
+
+        if (!ReadInteger(file, optional_header + (is_64 ? 24 : 28), address_size_, false, image_base) ||
+            !ReadInteger(file, optional_header + 60, 4, false, headers_size))
+        {
+            return false;
+        }
+
+        if (!add_segment(image_base, headers_size, 0, headers_size))
+        {
+            return false;
+        }
+
+        const uint64_t section_headers = optional_header + optional_header_size;
+
+        for (uint64_t i = 0; i < section_count; ++i)
+        {
+            const uint64_t header = section_headers + (i * 40);
+
+            uint64_t virtual_size = 0;
+            uint64_t virtual_address = 0;
+            uint64_t raw_size = 0;
+            uint64_t raw_offset = 0;
+
+            if (!ReadInteger(file, header + 8, 4, false, virtual_size) ||
+                !ReadInteger(file, header + 12, 4, false, virtual_address) ||
+                !ReadInteger(file, header + 16, 4, false, raw_size) ||
+                !ReadInteger(file, header + 20, 4, false, raw_offset))
+            {
+                return false;
+            }
+
+            if (virtual_size == 0)
+            {
+                virtual_size = raw_size;
+            }
+
+            if (!add_segment(image_base + virtual_address, virtual_size, raw_offset, std::min(raw_size, virtual_size)))
+            {
+                return false;
+            }
+        }
+
+        return map_segments();
+    }
+
+    void image_source::load_raw(uint64_t base)
+    {
+        format_ = image_format::raw;
+
+        ranges_.clear();
+        data_->segments.clear();
+        data_->segments.emplace_back(base, mapping_->size(), mapping_->data());
+    }
+
+    bool image_source::add_segment(uint64_t start, uint64_t memory_size, uint64_t file_offset, uint64_t file_size)
+    {
+        const mapped_file& file = *mapping_;
+
+        if (memory_size == 0)
+        {
+            return true;
+        }
+
+        if ((memory_size > max_segment_size) || (start + memory_size < start))
+        {
+            return false;
+        }
+
+        // Truncated files are treated as if the missing bytes were zero
+        if (file_offset > file.size())
+        {
+            file_size = 0;
+        }
+
+        file_size = std::min<uint64_t>({ file_size, memory_size, file.size() - std::min<uint64_t>(file_offset, file.size()) });
+
+        ranges_.push_back(segment_range { start, memory_size, file_offset, file_size });
+
+        return true;
+    }
+
+    bool image_source::map_segments()
+    {
+        const mapped_file& file = *mapping_;
+
+        std::stable_sort(ranges_.begin(), ranges_.end(), [ ] (const segment_range& lhs, const segment_range& rhs)
+        {
+            return lhs.start < rhs.start;
+        });
+
+        // Lookups assume segments don't overlap, so the first one mapped at an address wins.
+        // Overlaps are dropped before anything is allocated, and the total size of the zero filled copies is capped.
+        std::vector<segment_range> ranges;
+        uint64_t copied_size = 0;
+
+        ranges.reserve(ranges_.size());
+
+        for (const segment_range& range : ranges_)
+        {
+            if (!ranges.empty() && (range.start < ranges.back().start + ranges.back().memory_size))
+            {
+                continue;
+            }
+
+            if (range.file_size != range.memory_size)
+            {
+                copied_size += range.memory_size;
+
+                if (copied_size > max_copied_size)
+                {
+                    ranges_.clear();
+
+                    return false;
+                }
+            }
+
+            ranges.push_back(range);
+        }
+
+        ranges_.clear();
+
+        std::vector<view_segment>& segments = data_->segments;
+
+        segments.reserve(ranges.size());
+
+        for (const segment_range& range : ranges)
+        {
+            if (range.file_size == range.memory_size)
+            {
+                segments.emplace_back(range.start, range.memory_size, file.data() + range.file_offset);
+            }
+            else
+            {
+                std::unique_ptr<uint8_t[ ]> buffer(new uint8_t[static_cast<size_t>(range.memory_size)]());
+
+                if (range.file_size)
+                {
+                    std::memcpy(buffer.get(), file.data() + range.file_offset, static_cast<size_t>(range.file_size));
+                }
+
+                segments.emplace_back(range.start, range.memory_size, std::move(buffer));
+            }
+        }
+
+        return !segments.empty();
+    }
+}
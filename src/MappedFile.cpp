@@ -0,0 +1,155 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#    define WIN32_LEAN_AND_MEAN
+#    include <Windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#include <vector>
+
+namespace brick
+{
+    mapped_file::~mapped_file()
+    {
+        close();
+    }
+
+#if defined(_WIN32)
+    bool mapped_file::open(const std::string& file_name)
+    {
+        close();
+
+        int wide_length = MultiByteToWideChar(CP_UTF8, 0, file_name.c_str(), -1, nullptr, 0);
+
+        if (wide_length <= 0)
+            return false;
+
+        std::vector<wchar_t> wide_name(wide_length);
+
+        MultiByteToWideChar(CP_UTF8, 0, file_name.c_str(), -1, wide_name.data(), wide_length);
+
+        HANDLE file = CreateFileW(wide_name.data(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, nullptr);
+
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        file_ = file;
+
+        LARGE_INTEGER file_size;
+
+        if (!GetFileSizeEx(file, &file_size) || (file_size.QuadPart <= 0) ||
+            (static_cast<uint64_t>(file_size.QuadPart) > SIZE_MAX))
+        {
+            close();
+
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        if (!mapping)
+        {
+            close();
+
+            return false;
+        }
+
+        mapping_ = mapping;
+
+        const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+        if (!view)
+        {
+            close();
+
+            return false;
+        }
+
+        data_ = static_cast<const uint8_t*>(view);
+        size_ = static_cast<size_t>(file_size.QuadPart);
+
+        return true;
+    }
+
+    void mapped_file::close()
+    {
+        if (data_)
+            UnmapViewOfFile(data_);
+
+        if (mapping_)
+            CloseHandle(mapping_);
+
+        if (file_)
+            CloseHandle(file_);
+
+        data_ = nullptr;
+        size_ = 0;
+        mapping_ = nullptr;
+        file_ = nullptr;
+    }
+#else
+    bool mapped_file::open(const std::string& file_name)
+    {
+        close();
+
+        int fd = ::open(file_name.c_str(), O_RDONLY);
+
+        if (fd == -1)
+            return false;
+
+        struct stat file_stat;
+
+        if ((fstat(fd, &file_stat) != 0) || (file_stat.st_size <= 0))
+        {
+            ::close(fd);
+
+            return false;
+        }
+
+        void* view = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+        ::close(fd);
+
+        if (view == MAP_FAILED)
+            return false;
+
+        data_ = static_cast<const uint8_t*>(view);
+        size_ = static_cast<size_t>(file_stat.st_size);
+
+        return true;
+    }
+
+    void mapped_file::close()
+    {
+        if (data_)
+            munmap(const_cast<uint8_t*>(data_), size_);
+
+        data_ = nullptr;
+        size_ = 0;
+    }
+#endif
+}
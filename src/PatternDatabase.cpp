@@ -0,0 +1,325 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "PatternDatabase.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace brick
+{
+    constexpr char pattern_database::magic[8];
+    constexpr uint32_t pattern_database::version;
+
+    static bool in_bounds(uint64_t offset, uint64_t size, uint64_t total)
+    {
+        return (offset <= total) && (size <= total - offset);
+    }
+
+    bool pattern_database::is_database(const std::string& file_name)
+    {
+        std::ifstream file(file_name, std::ios::binary);
+
+        char buffer[sizeof(magic)];
+
+        if (!file.read(buffer, sizeof(buffer)))
+        {
+            return false;
+        }
+
+        return std::memcmp(buffer, magic, sizeof(magic)) == 0;
+    }
+
+    bool pattern_database::open(const std::string& file_name)
+    {
+        std::unique_ptr<mapped_file> mapping(new mapped_file());
+
+        if (!mapping->open(file_name) || !load(mapping->data(), mapping->size()))
+        {
+            return false;
+        }
+
+        mapping_ = std::move(mapping);
+        buffer_.clear();
+
+        return true;
+    }
+
+    bool pattern_database::open(std::vector<uint8_t> buffer)
+    {
+        if (!load(buffer.data(), buffer.size()))
+        {
+            return false;
+        }
+
+        // Moving the vector keeps its storage, so the pointers set by load stay valid
+        buffer_ = std::move(buffer);
+        mapping_.reset();
+
+        return true;
+    }
+
+    bool pattern_database::load(const uint8_t* data, size_t size)
+    {
+        header_ = nullptr;
+        records_ = nullptr;
+
+        // Linked code is stored as 64-bit words
+        if (sizeof(size_t) != sizeof(uint64_t))
+        {
+            return false;
+        }
+
+        if (size < sizeof(file_header))
+        {
+            return false;
+        }
+
+        const file_header* header = reinterpret_cast<const file_header*>(data);
+
+        if (std::memcmp(header->magic, magic, sizeof(magic)) || (header->version != version))
+        {
+            return false;
+        }
+
+        if (!in_bounds(header->records_offset, uint64_t(header->entry_count) * sizeof(file_record), size) ||
+            (header->records_offset % alignof(file_record)))
+        {
+            return false;
+        }
+
+        // Every string is null terminated, so it is enough for the table to end with one
+        if (!in_bounds(header->strings_offset, header->strings_size, size) || (header->strings_size == 0) ||
+            (data[header->strings_offset + header->strings_size - 1] != 0))
+        {
+            return false;
+        }
+
+        if (!in_bounds(header->bytes_offset, header->bytes_size, size) ||
+            !in_bounds(header->masks_offset, header->bytes_size, size))
+        {
+            return false;
+        }
+
+        if ((header->code_size > SIZE_MAX / sizeof(uint64_t)) ||
+            !in_bounds(header->code_offset, header->code_size * sizeof(uint64_t), size) ||
+            (header->code_offset % alignof(uint64_t)))
+        {
+            return false;
+        }
+
+        const file_record* records = reinterpret_cast<const file_record*>(data + header->records_offset);
+        const uint64_t* code = reinterpret_cast<const uint64_t*>(data + header->code_offset);
+
+        for (size_t i = 0; i < header->entry_count; ++i)
+        {
+            const file_record& record = records[i];
+
+            if ((record.name >= header->strings_size) || (record.category >= header->strings_size) ||
+                (record.pattern_string >= header->strings_size) || (record.ops_string >= header->strings_size))
+            {
+                return false;
+            }
+
+            if ((record.pattern_size == 0) || !in_bounds(record.pattern_offset, record.pattern_size, header->bytes_size))
+            {
+                return false;
+            }
+
+            if (!in_bounds(record.code_offset, record.code_size, header->code_size))
+            {
+                return false;
+            }
+
+            // The code is run without any bounds checks, so it must be verified like freshly linked code
+            if (record.code_size != 0)
+            {
+                size_t max_stack = 0;
+
+                if (!mem::sm::verify(reinterpret_cast<const size_t*>(code + record.code_offset), record.code_size, max_stack))
+                {
+                    return false;
+                }
+            }
+        }
+
+        header_ = header;
+        records_ = records;
+        strings_ = reinterpret_cast<const char*>(data + header->strings_offset);
+        bytes_ = data + header->bytes_offset;
+        masks_ = data + header->masks_offset;
+        code_ = code;
+
+        return true;
+    }
+
+    pattern_database::entry pattern_database::operator[](size_t index) const
+    {
+        const file_record& record = records_[index];
+
+        entry result;
+
+        result.name = strings_ + record.name;
+        result.category = strings_ + record.category;
+        result.pattern_string = strings_ + record.pattern_string;
+        result.ops_string = strings_ + record.ops_string;
+
+        result.bytes = bytes_ + record.pattern_offset;
+        result.masks = masks_ + record.pattern_offset;
+        result.size = record.pattern_size;
+
+        result.code = reinterpret_cast<const size_t*>(code_ + record.code_offset);
+        result.code_size = record.code_size;
+
+        result.flags = record.flags;
+
+        result.count = record.count;
+        result.index = record.index;
+
+        return result;
+    }
+
+    pattern_database_builder::pattern_database_builder()
+    {
+        // Keeps the string table non-empty, and gives every empty string the same offset
+        add_string("");
+    }
+
+    uint32_t pattern_database_builder::add_string(const std::string& value)
+    {
+        auto find = string_offsets_.find(value);
+
+        if (find != string_offsets_.end())
+        {
+            return find->second;
+        }
+
+        const uint32_t offset = uint32_t(strings_.size());
+
+        strings_.insert(strings_.end(), value.c_str(), value.c_str() + value.size() + 1);
+        string_offsets_.emplace(value, offset);
+
+        return offset;
+    }
+
+    bool pattern_database_builder::add(const std::string& name, const std::string& category,
+        const std::string& pattern_string, const mem::pattern& pattern, const std::string& ops_string,
+        const mem::sm::program* program, uint32_t flags, size_t count, size_t index)
+    {
+        const auto fits = [ ] (uint64_t used, uint64_t added)
+        {
+            return (used <= UINT32_MAX) && (added <= UINT32_MAX - used);
+        };
+
+        const size_t string_size = name.size() + category.size() + pattern_string.size() + ops_string.size() + 4;
+        const size_t code_size = program ? program->code.size() : 0;
+
+        if ((count > UINT32_MAX) || (index > UINT32_MAX) || !fits(strings_.size(), string_size) ||
+            !fits(bytes_.size(), pattern.size()) || !fits(code_.size(), code_size) || !fits(records_.size(), 1))
+        {
+            return false;
+        }
+
+        pattern_database::file_record record {};
+
+        record.name = add_string(name);
+        record.category = add_string(category);
+        record.pattern_string = add_string(pattern_string);
+        record.ops_string = add_string(ops_string);
+
+        record.pattern_offset = uint32_t(bytes_.size());
+        record.pattern_size = uint32_t(pattern.size());
+
+        bytes_.insert(bytes_.end(), pattern.bytes(), pattern.bytes() + pattern.size());
+        masks_.insert(masks_.end(), pattern.masks(), pattern.masks() + pattern.size());
+
+        if (program)
+        {
+            // Identical ops always link to identical code
+            auto find = code_offsets_.find(ops_string);
+
+            if (find != code_offsets_.end())
+            {
+                record.code_offset = find->second;
+            }
+            else
+            {
+                record.code_offset = uint32_t(code_.size());
+
+                code_.insert(code_.end(), program->code.begin(), program->code.end());
+                code_offsets_.emplace(ops_string, record.code_offset);
+            }
+
+            record.code_size = uint32_t(program->code.size());
+        }
+
+        record.flags = flags;
+        record.count = uint32_t(count);
+        record.index = uint32_t(index);
+
+        records_.push_back(record);
+
+        return true;
+    }
+
+    std::vector<uint8_t> pattern_database_builder::build() const
+    {
+        const auto align = [ ] (size_t value) -> size_t
+        {
+            return (value + 7) & ~size_t(7);
+        };
+
+        pattern_database::file_header header {};
+
+        std::memcpy(header.magic, pattern_database::magic, sizeof(header.magic));
+        header.version = pattern_database::version;
+        header.entry_count = uint32_t(records_.size());
+
+        header.records_offset = align(sizeof(header));
+
+        header.strings_offset = header.records_offset + (records_.size() * sizeof(pattern_database::file_record));
+        header.strings_size = strings_.size();
+
+        header.bytes_offset = header.strings_offset + header.strings_size;
+        header.masks_offset = header.bytes_offset + bytes_.size();
+        header.bytes_size = bytes_.size();
+
+        header.code_offset = align(header.masks_offset + masks_.size());
+        header.code_size = code_.size();
+
+        std::vector<uint8_t> result(header.code_offset + (code_.size() * sizeof(uint64_t)));
+
+        const auto write = [&] (uint64_t offset, const void* data, size_t size)
+        {
+            if (size != 0)
+            {
+                std::memcpy(&result[offset], data, size);
+            }
+        };
+
+        write(0, &header, sizeof(header));
+        write(header.records_offset, records_.data(), records_.size() * sizeof(pattern_database::file_record));
+        write(header.strings_offset, strings_.data(), strings_.size());
+        write(header.bytes_offset, bytes_.data(), bytes_.size());
+        write(header.masks_offset, masks_.data(), masks_.size());
+        write(header.code_offset, code_.data(), code_.size() * sizeof(uint64_t));
+
+        return result;
+    }
+}
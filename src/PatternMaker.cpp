@@ -18,6 +18,10 @@
 */
 
 #include "PatternMaker.h"
+#include "BackgroundTaskThread.h"
+#include "ParallelFunctions.h"
+#include "SimdScanner.h"
+#include "SuffixIndex.h"
 
 #include <mem/data_buffer.h>
 #include <mem/pattern.h>
@@ -25,6 +29,16 @@
 
 #include <Zydis/Zydis.h>
 
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
 #if defined(_WIN32)
 #    define WIN32_LEAN_AND_MEAN
 #    include <Windows.h>
@@ -119,42 +133,31 @@ struct X86MaskDecoder : InstructionMaskDecoder
     }
 };
 
-void GenerateSignature(Ref<BinaryView> view, uint64_t addr)
+std::unique_ptr<InstructionMaskDecoder> CreateMaskDecoder(Ref<Architecture> arch)
 {
-    Ref<BasicBlock> block = view->GetRecentBasicBlockForAddress(addr);
-
-    if (!block)
-    {
-        BinjaLog(ErrorLog, "Unknown Address");
-
-        return;
-    }
-
-    Ref<Function> func = block->GetFunction();
-    Ref<Architecture> arch = func->GetArchitecture();
-
     std::string arch_name = arch->GetName();
 
-    std::unique_ptr<InstructionMaskDecoder> decoder;
-
     if (arch_name == "x86" || arch_name == "x86_64")
     {
-        decoder = std::make_unique<X86MaskDecoder>(arch->GetAddressSize());
+        return std::make_unique<X86MaskDecoder>(arch->GetAddressSize());
     }
-    else
-    {
-        BinjaLog(ErrorLog, "Unknown architecture: {}", arch_name);
 
-        return;
-    }
+    return nullptr;
+}
 
-    mem::byte_buffer insn_buffer(arch->GetMaxInstructionLength());
-    mem::byte_buffer mask_buffer(arch->GetMaxInstructionLength());
+// Creates the shortest pattern which only matches at addr. On failure, returns false and sets result to the reason.
+// If an index is given, it is used to count matches instead of scanning.
+bool CreateSignature(Ref<BinaryView> view, const brick::view_data& scan_data, const brick::suffix_index* index,
+    InstructionMaskDecoder& decoder, size_t max_insn_length, uint64_t addr, std::string& result)
+{
+    mem::byte_buffer insn_buffer(max_insn_length);
+    mem::byte_buffer mask_buffer(max_insn_length);
 
     mem::byte_buffer bytes;
     mem::byte_buffer masks;
 
-    brick::view_data scan_data(view);
+    std::vector<uint64_t> candidates;
+    bool scanned = false;
 
     uint64_t current_addr = addr;
 
@@ -164,20 +167,20 @@ void GenerateSignature(Ref<BinaryView> view, uint64_t addr)
 
         if (len == 0)
         {
-            BinjaLog(ErrorLog, "Failed to read data : 0x{:X}", current_addr);
+            result = fmt::format("Failed to read data : 0x{:X}", current_addr);
 
-            break;
+            return false;
         }
 
         std::memset(mask_buffer.data(), 0xFF, len);
 
-        len = decoder->Decode(current_addr, insn_buffer.data(), len, mask_buffer.data());
+        len = decoder.Decode(current_addr, insn_buffer.data(), len, mask_buffer.data());
 
         if (len == 0)
         {
-            BinjaLog(ErrorLog, "Failed to decode instruction @ 0x{:X}", current_addr);
+            result = fmt::format("Failed to decode instruction @ 0x{:X}", current_addr);
 
-            break;
+            return false;
         }
 
         bytes.append(insn_buffer.data(), len);
@@ -187,36 +190,327 @@ void GenerateSignature(Ref<BinaryView> view, uint64_t addr)
 
         if (pat.size() >= 5)
         {
-            bool found = false;
-
-            scan_data(mem::default_scanner(pat), [&](uint64_t result) {
-                if (addr == result)
-                    return false;
-
-                found = true;
-
-                return true;
-            });
+            if (index)
+            {
+                // Any match other than addr means the pattern is not unique yet
+                candidates = index->find(pat, 2);
+            }
+            // Scan once for the first prefix, after that every extension can only narrow down the previous matches
+            else if (!scanned)
+            {
+                candidates = scan_data.scan_all(brick::simd_scanner(pat, &scan_data.histogram()), pat.size());
 
-            if (!found)
+                scanned = true;
+            }
+            else
             {
-                std::string pat_string = pat.to_string();
+                candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&] (uint64_t candidate)
+                {
+                    return !scan_data.match(candidate, pat);
+                }), candidates.end());
+            }
 
-                CopyToClipboard(pat_string);
+            candidates.erase(std::remove(candidates.begin(), candidates.end(), addr), candidates.end());
 
-                BinjaLog(InfoLog, "Generated Pattern: \"{}\"", pat_string);
+            if (candidates.empty())
+            {
+                result = pat.to_string();
 
-                break;
+                return true;
             }
         }
 
         if (pat.size() > 256)
         {
-            BinjaLog(ErrorLog, "Pattern too long");
+            result = "Pattern too long";
 
-            break;
+            return false;
         }
 
         current_addr += len;
     }
-}
\ No newline at end of file
+}
+
+void GenerateSignature(Ref<BinaryView> view, uint64_t addr)
+{
+    Ref<BasicBlock> block = view->GetRecentBasicBlockForAddress(addr);
+
+    if (!block)
+    {
+        BinjaLog(ErrorLog, "Unknown Address");
+
+        return;
+    }
+
+    Ref<Function> func = block->GetFunction();
+    Ref<Architecture> arch = func->GetArchitecture();
+
+    std::unique_ptr<InstructionMaskDecoder> decoder = CreateMaskDecoder(arch);
+
+    if (!decoder)
+    {
+        BinjaLog(ErrorLog, "Unknown architecture: {}", arch->GetName());
+
+        return;
+    }
+
+    std::shared_ptr<const brick::view_data> scan_data = brick::get_view_data(view);
+
+    std::string pat_string;
+
+    if (!CreateSignature(view, *scan_data, nullptr, *decoder, arch->GetMaxInstructionLength(), addr, pat_string))
+    {
+        BinjaLog(ErrorLog, "{}", pat_string);
+
+        return;
+    }
+
+    CopyToClipboard(pat_string);
+
+    BinjaLog(InfoLog, "Generated Pattern: \"{}\"", pat_string);
+}
+
+// A function to create a signature for, under the name it is written with
+struct SignatureTarget
+{
+    std::string name;
+    uint64_t address {0};
+    Ref<Architecture> arch;
+};
+
+struct FunctionSignature
+{
+    std::string name;
+    std::string pattern;
+    bool success {false};
+};
+
+static SignatureTarget GetFunctionTarget(Ref<Function> func)
+{
+    SignatureTarget target;
+
+    target.name = func->GetSymbol()->GetFullName();
+    target.address = func->GetStart();
+    target.arch = func->GetArchitecture();
+
+    return target;
+}
+
+void GenerateSignaturesTask(Ref<BackgroundTask> task, Ref<BinaryView> view, std::vector<SignatureTarget> targets, std::string file_name)
+{
+    using stopwatch = std::chrono::steady_clock;
+
+    const auto start_time = stopwatch::now();
+
+    task->SetProgressText("Creating signatures (Indexing)");
+
+    // Thousands of uniqueness queries against the same view quickly pay for building the index
+    std::shared_ptr<const brick::suffix_index> suffix = brick::get_suffix_index(view);
+    std::shared_ptr<const brick::view_data> scan_data = suffix->data();
+
+    std::vector<FunctionSignature> signatures(targets.size());
+
+    std::vector<size_t> indices(targets.size());
+    std::iota(indices.begin(), indices.end(), 0);
+
+    std::atomic_size_t completed {0};
+
+    parallel_for_each(indices.begin(), indices.end(), [&] (size_t index) -> bool
+    {
+        if (task->IsCancelled())
+        {
+            return false;
+        }
+
+        const SignatureTarget& target = targets[index];
+
+        FunctionSignature& signature = signatures[index];
+
+        signature.name = target.name;
+
+        std::unique_ptr<InstructionMaskDecoder> decoder = CreateMaskDecoder(target.arch);
+
+        if (decoder)
+        {
+            signature.success = CreateSignature(view, *scan_data, suffix.get(), *decoder,
+                target.arch->GetMaxInstructionLength(), target.address, signature.pattern);
+        }
+        else
+        {
+            signature.pattern = fmt::format("Unknown architecture: {}", target.arch->GetName());
+        }
+
+        size_t done = ++completed;
+
+        if ((done % 100) == 0)
+        {
+            task->SetProgressText(fmt::format("Creating signatures ({}/{})", done, targets.size()));
+        }
+
+        return true;
+    });
+
+    if (task->IsCancelled())
+    {
+        return;
+    }
+
+    // Overloaded or duplicate names would otherwise overwrite each other's symbols when the file is loaded
+    std::unordered_map<std::string, size_t> name_counts;
+
+    for (const FunctionSignature& signature : signatures)
+    {
+        if (signature.success)
+        {
+            ++name_counts[signature.name];
+        }
+    }
+
+    YAML::Emitter output;
+
+    output << YAML::BeginMap << YAML::Key << "patterns" << YAML::Value << YAML::BeginSeq;
+
+    size_t total = 0;
+
+    for (size_t i = 0; i < signatures.size(); ++i)
+    {
+        const FunctionSignature& signature = signatures[i];
+
+        if (!signature.success)
+        {
+            BinjaLog(WarningLog, "Failed to create signature for {}: {}", signature.name, signature.pattern);
+
+            continue;
+        }
+
+        std::string name = signature.name;
+
+        if (name_counts[name] > 1)
+        {
+            name = fmt::format("{}_{:X}", name, targets[i].address);
+        }
+
+        output << YAML::BeginMap;
+        output << YAML::Key << "name" << YAML::Value << name;
+        output << YAML::Key << "category" << YAML::Value << "Function";
+        output << YAML::Key << "pattern" << YAML::Value << signature.pattern;
+        output << YAML::EndMap;
+
+        ++total;
+    }
+
+    output << YAML::EndSeq << YAML::EndMap;
+
+    std::ofstream file(file_name);
+
+    if (!file)
+    {
+        BinjaLog(ErrorLog, "Failed to open \"{}\"", file_name);
+
+        return;
+    }
+
+    file << output.c_str() << std::endl;
+
+    const auto end_time = stopwatch::now();
+
+    const auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+
+    BinjaLog(InfoLog, "Created {} signatures for {} functions in {} ms\n", total, targets.size(), elapsed_ms);
+}
+
+static void StartSignaturesTask(Ref<BinaryView> view, std::vector<SignatureTarget> targets)
+{
+    if (targets.empty())
+    {
+        BinjaLog(ErrorLog, "No functions to create signatures for");
+
+        return;
+    }
+
+    std::string output_file;
+
+    if (BinaryNinja::GetSaveFileNameInput(output_file, "Save Pattern File", "*.yml;*.yaml"))
+    {
+        Ref<BackgroundTaskThread> task = new BackgroundTaskThread("Creating Signatures");
+
+        task->Run(&GenerateSignaturesTask, view, std::move(targets), output_file);
+    }
+}
+
+void GenerateSignatures(Ref<BinaryView> view)
+{
+    std::vector<SignatureTarget> targets;
+
+    for (const Ref<Function>& func : view->GetAnalysisFunctionList())
+    {
+        targets.push_back(GetFunctionTarget(func));
+    }
+
+    StartSignaturesTask(view, std::move(targets));
+}
+
+void GenerateSelectionSignatures(Ref<BinaryView> view, uint64_t start, uint64_t length)
+{
+    std::vector<SignatureTarget> targets;
+
+    for (const Ref<Function>& func : view->GetAnalysisFunctionList())
+    {
+        if ((func->GetStart() >= start) && (func->GetStart() - start < length))
+        {
+            targets.push_back(GetFunctionTarget(func));
+        }
+    }
+
+    // A selection inside a single function means that function
+    if (targets.empty())
+    {
+        for (const Ref<Function>& func : view->GetAnalysisFunctionsForAddress(start))
+        {
+            targets.push_back(GetFunctionTarget(func));
+        }
+    }
+
+    StartSignaturesTask(view, std::move(targets));
+}
+
+void GenerateSymbolSignatures(Ref<BinaryView> view)
+{
+    std::vector<SignatureTarget> targets;
+    std::unordered_set<uint64_t> addresses;
+
+    for (const Ref<Symbol>& symbol : view->GetSymbols())
+    {
+        if (symbol->GetType() != FunctionSymbol)
+        {
+            continue;
+        }
+
+        const uint64_t address = symbol->GetAddress();
+
+        // Only the first symbol at each function start, an address can have several names
+        if (addresses.count(address))
+        {
+            continue;
+        }
+
+        for (const Ref<Function>& func : view->GetAnalysisFunctionsForAddress(address))
+        {
+            if (func->GetStart() == address)
+            {
+                SignatureTarget target;
+
+                target.name = symbol->GetFullName();
+                target.address = address;
+                target.arch = func->GetArchitecture();
+
+                targets.push_back(std::move(target));
+                addresses.insert(address);
+
+                break;
+            }
+        }
+    }
+
+    StartSignaturesTask(view, std::move(targets));
+}
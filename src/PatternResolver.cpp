@@ -0,0 +1,963 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "PatternResolver.h"
+#include "ParallelFunctions.h"
+#include "StackMachine.h"
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+#include <mem/pattern.h>
+#include <mem/utils.h>
+
+#include <fmt/format.h>
+
+#include <yaml-cpp/eventhandler.h>
+#include <yaml-cpp/yaml.h>
+
+using stopwatch = std::chrono::steady_clock;
+
+namespace brick
+{
+    template <typename String, typename... Args>
+    static void Log(const log_function& log, log_level level, const String& format, const Args&... args)
+    {
+        if (log)
+        {
+            log(level, fmt::format(format, args...));
+        }
+    }
+
+    // Collects the messages of entries evaluated in parallel. Errors are rare, so a single locked list is enough.
+    class MessageList
+    {
+    public:
+        void Add(size_t entry, log_level level, std::string text)
+        {
+            std::lock_guard<std::mutex> guard(lock_);
+
+            messages_.push_back(pattern_message {entry, level, std::move(text)});
+        }
+
+        // Each entry is evaluated on one thread, so a stable sort keeps its messages in the order they were logged
+        std::vector<pattern_message> Take()
+        {
+            std::stable_sort(messages_.begin(), messages_.end(), [ ] (const pattern_message& lhs, const pattern_message& rhs)
+            {
+                return lhs.entry < rhs.entry;
+            });
+
+            return std::move(messages_);
+        }
+
+    private:
+        std::mutex lock_;
+        std::vector<pattern_message> messages_;
+    };
+
+    struct EntryLog
+    {
+        MessageList& messages;
+        size_t entry;
+    };
+
+    template <typename String, typename... Args>
+    static void Log(const EntryLog& log, log_level level, const String& format, const Args&... args)
+    {
+        log.messages.Add(log.entry, level, fmt::format(format, args...));
+    }
+
+    // Reads directly from the view_data snapshot, only going through the source for addresses outside of it
+    struct PatternEnvironment
+    {
+        const byte_source& source;
+        const view_data& data;
+
+        size_t here {0};
+
+        PatternEnvironment(const byte_source& source_, const view_data& data_)
+            : source(source_)
+            , data(data_)
+        { }
+
+        bool read_integer(size_t addr, size_t size, size_t& out) const
+        {
+            if (size == 0)
+            {
+                size = source.address_size();
+            }
+
+            if (size > sizeof(size_t))
+            {
+                return false;
+            }
+
+            uint8_t buffer[sizeof(size_t)];
+
+            if (!data.read(addr, buffer, size) && !source.read(addr, buffer, size))
+            {
+                return false;
+            }
+
+            const bool big_endian = source.big_endian();
+
+            size_t result = 0;
+
+            for (size_t i = 0; i < size; ++i)
+            {
+                result |= size_t(buffer[big_endian ? (size - i - 1) : i]) << (i * 8);
+            }
+
+            out = result;
+
+            return true;
+        }
+
+        bool resolve_symbol(size_t sym, size_t& out) const
+        {
+            switch (sym)
+            {
+                case mem::sm::sym_here:
+                {
+                    out = here;
+
+                    return true;
+                };
+            }
+
+            return false;
+        }
+    };
+
+    // Compiled ops expressions, shared by every entry and every pattern file loaded in this session
+    class ExpressionCache
+    {
+    public:
+        // Returns null if the expression is invalid
+        std::shared_ptr<const mem::sm::program> Get(const std::string& ops_string, expression_stats& stats)
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock_);
+
+                auto find = programs_.find(ops_string);
+
+                if (find != programs_.end())
+                {
+                    ++stats.hits;
+
+                    return find->second;
+                }
+            }
+
+            const auto compile_start_time = stopwatch::now();
+
+            std::vector<size_t> code;
+            std::shared_ptr<mem::sm::program> program = std::make_shared<mem::sm::program>();
+
+            if (!mem::sm::compile_infix(ops_string.c_str(), code) || !mem::sm::link(code, *program))
+            {
+                program = nullptr;
+            }
+
+            const auto compile_end_time = stopwatch::now();
+
+            ++stats.misses;
+            stats.compile_us += std::chrono::duration_cast<std::chrono::microseconds>(compile_end_time - compile_start_time).count();
+
+            std::lock_guard<std::mutex> guard(lock_);
+
+            // Another thread may have compiled the same expression in the meantime, keep the first one
+            return programs_.emplace(ops_string, std::move(program)).first->second;
+        }
+
+    private:
+        std::mutex lock_;
+        std::unordered_map<std::string, std::shared_ptr<const mem::sm::program>> programs_;
+    };
+
+    static ExpressionCache& GetExpressionCache()
+    {
+        static ExpressionCache cache;
+
+        return cache;
+    }
+
+    // Evaluates the matches of one entry in place
+    static void EvaluatePatternEntry(const byte_source& source, const view_data& data, const pattern_database::entry& info,
+        pattern_result& entry, const EntryLog& log, uint64_t* scan_results, size_t count)
+    {
+        const char* name = info.name;
+
+        if (count == 0)
+        {
+            Log(log, log_level::error, "Pattern \"{}\" (\"{}\") not found", name, info.pattern_string);
+
+            return;
+        }
+
+        if (info.flags & pattern_database::flag_invalid_ops)
+        {
+            Log(log, log_level::error, "Invalid Operands for {}", name);
+
+            return;
+        }
+
+        if (info.flags & pattern_database::flag_has_ops)
+        {
+            if (info.flags & pattern_database::flag_ops_error)
+            {
+                Log(log, log_level::error, "Error parsing \"{}\"", info.ops_string);
+
+                return;
+            }
+
+            PatternEnvironment env(source, data);
+
+            size_t evaluated = 0;
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                env.here = scan_results[i];
+
+                size_t result = SIZE_MAX;
+
+                if (mem::sm::run(info.code, info.code_size, env, result))
+                {
+                    scan_results[evaluated++] = result;
+                }
+                else
+                {
+                    Log(log, log_level::error, "Eval Failed");
+                }
+            }
+
+            count = evaluated;
+        }
+
+        if (count == 0)
+        {
+            Log(log, log_level::error, "Not Found: {}\n", name);
+        }
+
+        const bool unique = (count != 0) && std::all_of(scan_results + 1, scan_results + count, [&] (uint64_t result)
+        {
+            return result == scan_results[0];
+        });
+
+        uint64_t result = 0;
+
+        if (unique)
+        {
+            result = scan_results[0];
+        }
+        else
+        {
+            if (info.count != count)
+            {
+                Log(log, log_level::error, "{}: Invalid Count: (Got {}, Expected {})", name, count, info.count);
+
+                return;
+            }
+
+            if (info.index >= count)
+            {
+                Log(log, log_level::error, "{}: Invalid Index: {}, {} Results", name, info.index, count);
+
+                return;
+            }
+
+            result = scan_results[info.index];
+        }
+
+        entry.found = true;
+        entry.offset = result;
+    }
+
+    struct PatternField
+    {
+        std::string value;
+
+        bool present {false};
+        bool scalar {false};
+    };
+
+    struct PatternFileEntry
+    {
+        size_t line {0};
+
+        PatternField name;
+        PatternField category;
+        PatternField pattern;
+        PatternField ops;
+        PatternField count;
+        PatternField index;
+
+        PatternField* Find(const std::string& key)
+        {
+            if (key == "name")
+                return &name;
+            if (key == "category")
+                return &category;
+            if (key == "pattern")
+                return &pattern;
+            if (key == "ops")
+                return &ops;
+            if (key == "count")
+                return &count;
+            if (key == "index")
+                return &index;
+
+            return nullptr;
+        }
+    };
+
+    // Compiles one parsed entry into the builder
+    static void AddPatternEntry(const std::string& file_name, const PatternFileEntry& entry,
+        pattern_database_builder& builder, expression_stats& stats, const log_function& log)
+    {
+        const auto get_size = [ ] (const PatternField& field, size_t fallback) -> size_t
+        {
+            return field.scalar ? YAML::Node(field.value).as<size_t>(fallback) : fallback;
+        };
+
+        for (const auto& field : { std::make_pair("name", &entry.name), std::make_pair("category", &entry.category),
+                 std::make_pair("pattern", &entry.pattern) })
+        {
+            if (!field.second->scalar)
+            {
+                Log(log, log_level::error, "Error parsing pattern file \"{}\" (line {}): missing \"{}\"", file_name, entry.line,
+                    field.first);
+
+                return;
+            }
+        }
+
+        std::shared_ptr<const mem::sm::program> program;
+        uint32_t flags = 0;
+
+        if (entry.ops.present)
+        {
+            if (entry.ops.scalar)
+            {
+                flags |= pattern_database::flag_has_ops;
+
+                program = GetExpressionCache().Get(entry.ops.value, stats);
+
+                if (!program)
+                {
+                    flags |= pattern_database::flag_ops_error;
+                }
+            }
+            else
+            {
+                flags |= pattern_database::flag_invalid_ops;
+            }
+        }
+
+        mem::pattern pattern(entry.pattern.value.c_str());
+
+        if (!pattern)
+        {
+            Log(log, log_level::error, "Pattern \"{}\" is empty or malformed", entry.pattern.value);
+
+            return;
+        }
+
+        const size_t count = get_size(entry.count, 1);
+        const size_t index = get_size(entry.index, 0);
+
+        // Both are stored as 32-bit values
+        if ((count > UINT32_MAX) || (index > UINT32_MAX))
+        {
+            Log(log, log_level::error, "Error parsing pattern file \"{}\" (line {}): count or index out of range", file_name,
+                entry.line);
+
+            return;
+        }
+
+        if (!builder.add(entry.name.value, entry.category.value, entry.pattern.value, pattern, entry.ops.value,
+                program.get(), flags, count, index))
+        {
+            Log(log, log_level::error, "Error parsing pattern file \"{}\" (line {}): too many patterns", file_name, entry.line);
+        }
+    }
+
+    // A node event inside an anchored subtree, kept so aliases to it can be replayed
+    struct PatternFileEvent
+    {
+        enum kind_t : uint8_t
+        {
+            null,
+            scalar,
+            sequence_start,
+            sequence_end,
+            map_start,
+            map_end,
+        };
+
+        kind_t kind;
+        YAML::Mark mark;
+        std::string value;
+    };
+
+    // Reads the patterns sequence from the event stream, without building a node tree.
+    // Anchored nodes are recorded as events and replayed in place of their aliases, and merge keys ("<<") inside an
+    // entry fill in any fields the entry does not set itself, so the result matches loading the file as a document.
+    class PatternFileReader : public YAML::EventHandler
+    {
+    public:
+        PatternFileReader(const std::string& file_name, pattern_database_builder& builder, expression_stats& stats,
+            const log_function& log)
+            : file_name_(file_name)
+            , builder_(builder)
+            , stats_(stats)
+            , log_(log)
+        { }
+
+        bool HasPatterns() const
+        {
+            return has_patterns_;
+        }
+
+        void OnDocumentStart(const YAML::Mark&) override
+        { }
+
+        void OnDocumentEnd() override
+        { }
+
+        void OnNull(const YAML::Mark& mark, YAML::anchor_t anchor) override
+        {
+            Handle(PatternFileEvent::null, mark, nullptr, anchor);
+        }
+
+        void OnAlias(const YAML::Mark& mark, YAML::anchor_t anchor) override
+        {
+            for (const Recording& recording : recording_)
+            {
+                if (recording.anchor == anchor)
+                {
+                    throw YAML::ParserException(mark, "recursive alias");
+                }
+            }
+
+            const std::vector<PatternFileEvent>& events = anchors_[anchor];
+
+            // Nested aliases can expand exponentially
+            replayed_ += events.size();
+
+            if (replayed_ > max_replayed_events)
+            {
+                throw YAML::ParserException(mark, "too many aliased nodes");
+            }
+
+            for (const PatternFileEvent& event : events)
+            {
+                Handle(event.kind, event.mark, &event.value, YAML::NullAnchor);
+            }
+        }
+
+        void OnScalar(const YAML::Mark& mark, const std::string&, YAML::anchor_t anchor, const std::string& value) override
+        {
+            Handle(PatternFileEvent::scalar, mark, &value, anchor);
+        }
+
+        void OnSequenceStart(const YAML::Mark& mark, const std::string&, YAML::anchor_t anchor, YAML::EmitterStyle::value) override
+        {
+            Handle(PatternFileEvent::sequence_start, mark, nullptr, anchor);
+        }
+
+        void OnSequenceEnd() override
+        {
+            Handle(PatternFileEvent::sequence_end, YAML::Mark::null_mark(), nullptr, YAML::NullAnchor);
+        }
+
+        void OnMapStart(const YAML::Mark& mark, const std::string&, YAML::anchor_t anchor, YAML::EmitterStyle::value) override
+        {
+            Handle(PatternFileEvent::map_start, mark, nullptr, anchor);
+        }
+
+        void OnMapEnd() override
+        {
+            Handle(PatternFileEvent::map_end, YAML::Mark::null_mark(), nullptr, YAML::NullAnchor);
+        }
+
+    private:
+        enum : size_t
+        {
+            depth_document,
+            depth_root,
+            depth_patterns,
+            depth_entry,
+            depth_merge_list,
+            depth_merge,
+        };
+
+        static constexpr size_t max_replayed_events = 1 << 24;
+
+        struct Recording
+        {
+            YAML::anchor_t anchor;
+            size_t depth;
+        };
+
+        const std::string& file_name_;
+        pattern_database_builder& builder_;
+        expression_stats& stats_;
+        const log_function& log_;
+
+        size_t depth_ {depth_document};
+
+        // Depth of a subtree which is being skipped
+        size_t skip_ {0};
+
+        // Whether the next node in the current map is a key
+        bool is_key_ {true};
+
+        std::string root_key_;
+        bool has_patterns_ {false};
+
+        PatternFileEntry entry_;
+        PatternField* field_ {nullptr};
+
+        // Whether the current entry value belongs to a merge key, and whether it is a sequence of maps
+        bool merge_ {false};
+        bool merge_list_ {false};
+
+        // yaml-cpp gives every anchor definition its own id, so a redefined anchor never overwrites an earlier one
+        std::unordered_map<YAML::anchor_t, std::vector<PatternFileEvent>> anchors_;
+        std::vector<Recording> recording_;
+        size_t replayed_ {0};
+
+        void Handle(PatternFileEvent::kind_t kind, const YAML::Mark& mark, const std::string* value, YAML::anchor_t anchor)
+        {
+            Record(kind, mark, value, anchor);
+
+            switch (kind)
+            {
+                case PatternFileEvent::null: Value(mark, nullptr); break;
+                case PatternFileEvent::scalar: Value(mark, value); break;
+                case PatternFileEvent::sequence_start: Begin(mark, true); break;
+                case PatternFileEvent::map_start: Begin(mark, false); break;
+                case PatternFileEvent::sequence_end:
+                case PatternFileEvent::map_end: End(); break;
+            }
+        }
+
+        void Record(PatternFileEvent::kind_t kind, const YAML::Mark& mark, const std::string* value, YAML::anchor_t anchor)
+        {
+            const bool is_start = (kind == PatternFileEvent::sequence_start) || (kind == PatternFileEvent::map_start);
+            const bool is_end = (kind == PatternFileEvent::sequence_end) || (kind == PatternFileEvent::map_end);
+
+            const auto append = [&] (YAML::anchor_t id)
+            {
+                anchors_[id].push_back(PatternFileEvent {kind, mark, value ? *value : std::string()});
+            };
+
+            for (Recording& recording : recording_)
+            {
+                append(recording.anchor);
+
+                if (is_start)
+                    ++recording.depth;
+                else if (is_end)
+                    --recording.depth;
+            }
+
+            while (!recording_.empty() && (recording_.back().depth == 0))
+            {
+                recording_.pop_back();
+            }
+
+            if (anchor != YAML::NullAnchor)
+            {
+                append(anchor);
+
+                if (is_start)
+                {
+                    recording_.push_back(Recording {anchor, 1});
+                }
+            }
+        }
+
+        void SetField(const std::string* value)
+        {
+            // Merged values never replace a value set by the entry itself, or by an earlier merged map
+            if (!field_ || ((depth_ == depth_merge) && field_->present))
+            {
+                return;
+            }
+
+            field_->present = true;
+            field_->scalar = value != nullptr;
+            field_->value = value ? *value : std::string();
+        }
+
+        void Begin(const YAML::Mark& mark, bool is_sequence)
+        {
+            if (skip_)
+            {
+                ++skip_;
+
+                return;
+            }
+
+            switch (depth_)
+            {
+                case depth_document:
+                {
+                    if (!is_sequence)
+                    {
+                        depth_ = depth_root;
+                        is_key_ = true;
+
+                        return;
+                    }
+                } break;
+
+                case depth_root:
+                {
+                    if (is_sequence && !is_key_ && (root_key_ == "patterns"))
+                    {
+                        depth_ = depth_patterns;
+                        has_patterns_ = true;
+
+                        return;
+                    }
+
+                    if (is_key_)
+                    {
+                        root_key_.clear();
+                    }
+                } break;
+
+                case depth_patterns:
+                {
+                    if (!is_sequence)
+                    {
+                        depth_ = depth_entry;
+                        is_key_ = true;
+
+                        entry_ = PatternFileEntry();
+                        entry_.line = mark.line + 1;
+
+                        return;
+                    }
+
+                    Log(log_, log_level::error, "Error parsing pattern file \"{}\" (line {}): expected a map", file_name_, mark.line + 1);
+                } break;
+
+                case depth_entry:
+                {
+                    if (!is_key_ && merge_)
+                    {
+                        merge_list_ = is_sequence;
+                        depth_ = is_sequence ? depth_merge_list : depth_merge;
+                        is_key_ = true;
+
+                        return;
+                    }
+                } /* fallthrough */
+
+                case depth_merge:
+                {
+                    // A sequence or map value, which is only meaningful (as invalid) for ops
+                    if (is_key_)
+                    {
+                        field_ = nullptr;
+                    }
+                    else
+                    {
+                        SetField(nullptr);
+                    }
+                } break;
+
+                case depth_merge_list:
+                {
+                    if (!is_sequence)
+                    {
+                        depth_ = depth_merge;
+                        is_key_ = true;
+
+                        return;
+                    }
+                } break;
+            }
+
+            skip_ = 1;
+        }
+
+        void End()
+        {
+            if (skip_)
+            {
+                if (--skip_ == 0)
+                {
+                    // The skipped subtree was a key or a value
+                    is_key_ = !is_key_;
+                }
+
+                return;
+            }
+
+            switch (depth_)
+            {
+                case depth_merge:
+                {
+                    if (merge_list_)
+                    {
+                        depth_ = depth_merge_list;
+
+                        break;
+                    }
+                } /* fallthrough */
+
+                case depth_merge_list:
+                {
+                    depth_ = depth_entry;
+                    is_key_ = true;
+                    merge_ = false;
+                    merge_list_ = false;
+                } break;
+
+                case depth_entry:
+                {
+                    AddPatternEntry(file_name_, entry_, builder_, stats_, log_);
+
+                    depth_ = depth_patterns;
+                } break;
+
+                case depth_patterns:
+                {
+                    depth_ = depth_root;
+                    is_key_ = true;
+                } break;
+
+                case depth_root:
+                {
+                    depth_ = depth_document;
+                } break;
+            }
+        }
+
+        void Value(const YAML::Mark& mark, const std::string* value)
+        {
+            if (skip_)
+            {
+                return;
+            }
+
+            switch (depth_)
+            {
+                case depth_root:
+                {
+                    if (is_key_)
+                    {
+                        root_key_ = value ? *value : std::string();
+                    }
+                } break;
+
+                case depth_patterns:
+                {
+                    Log(log_, log_level::error, "Error parsing pattern file \"{}\" (line {}): expected a map", file_name_, mark.line + 1);
+
+                    return;
+                }
+
+                case depth_entry:
+                {
+                    if (is_key_)
+                    {
+                        merge_ = value && (*value == "<<");
+                        field_ = value ? entry_.Find(*value) : nullptr;
+                    }
+                    else if (merge_)
+                    {
+                        Log(log_, log_level::error, "Error parsing pattern file \"{}\" (line {}): merge key expects a map",
+                            file_name_, mark.line + 1);
+
+                        merge_ = false;
+                    }
+                    else
+                    {
+                        SetField(value);
+                    }
+                } break;
+
+                case depth_merge:
+                {
+                    if (is_key_)
+                    {
+                        field_ = value ? entry_.Find(*value) : nullptr;
+                    }
+                    else
+                    {
+                        SetField(value);
+                    }
+                } break;
+
+                // Only maps (or aliases to them) can be merged
+                case depth_merge_list: return;
+
+                default: return;
+            }
+
+            is_key_ = !is_key_;
+        }
+    };
+
+    bool parse_pattern_file(const std::string& file_name, pattern_database_builder& builder, expression_stats& stats,
+        const log_function& log)
+    {
+        std::ifstream input(file_name, std::ios::binary);
+
+        if (!input)
+        {
+            Log(log, log_level::error, "Failed to open \"{}\"", file_name);
+
+            return false;
+        }
+
+        PatternFileReader reader(file_name, builder, stats, log);
+
+        try
+        {
+            YAML::Parser parser(input);
+
+            parser.HandleNextDocument(reader);
+        }
+        catch (const YAML::Exception& ex)
+        {
+            Log(log, log_level::error, "Error parsing pattern file \"{}\": {}", file_name, ex.what());
+
+            return false;
+        }
+
+        if (!reader.HasPatterns())
+        {
+            Log(log, log_level::error, "File does not contain any patterns");
+
+            return false;
+        }
+
+        return true;
+    }
+
+    bool load_pattern_file(const std::string& file_name, pattern_database& database, expression_stats& stats,
+        const log_function& log)
+    {
+        if (pattern_database::is_database(file_name))
+        {
+            if (!database.open(file_name))
+            {
+                Log(log, log_level::error, "Invalid pattern database \"{}\"", file_name);
+
+                return false;
+            }
+
+            return true;
+        }
+
+        pattern_database_builder builder;
+
+        if (!parse_pattern_file(file_name, builder, stats, log))
+        {
+            return false;
+        }
+
+        // The compiled database is the only copy of the file kept in memory
+        if (!database.open(builder.build()))
+        {
+            Log(log, log_level::error, "Failed to compile pattern file \"{}\"", file_name);
+
+            return false;
+        }
+
+        return true;
+    }
+
+    resolve_results resolve_patterns(const byte_source& source, const pattern_database& database,
+        resolve_timings* timings)
+    {
+        std::shared_ptr<const view_data> data = source.data();
+
+        // Matches the patterns in place, straight from the (possibly mapped) database
+        pattern_set patterns(database.pattern_bytes(), database.pattern_masks());
+
+        patterns.reserve(database.size());
+
+        for (size_t i = 0; i < database.size(); ++i)
+        {
+            const pattern_database::entry info = database[i];
+
+            patterns.add_external(info.bytes - database.pattern_bytes(), info.size);
+        }
+
+        patterns.compile();
+
+        const auto scan_start_time = stopwatch::now();
+
+        pattern_set_results pattern_results = data->scan_all(patterns);
+
+        const auto scan_end_time = stopwatch::now();
+
+        resolve_results results;
+        MessageList messages;
+
+        // Every database entry has exactly one pattern, with the same index
+        results.entries.resize(database.size());
+
+        parallel_for_each(results.entries.begin(), results.entries.end(), [&] (pattern_result& result) -> bool
+        {
+            const size_t index = &result - results.entries.data();
+            const pattern_database::entry info = database[index];
+            const EntryLog log {messages, index};
+
+            try
+            {
+                EvaluatePatternEntry(source, *data, info, result, log, pattern_results.data(index),
+                    pattern_results.count(index));
+            }
+            catch (const std::exception& ex)
+            {
+                Log(log, log_level::error, "Error evaluating pattern \"{}\": {}", info.name, ex.what());
+            }
+            catch (...)
+            {
+                Log(log, log_level::error, "Error evaluating pattern \"{}\"", info.name);
+            }
+
+            return true;
+        });
+
+        results.messages = messages.Take();
+
+        const auto evaluate_end_time = stopwatch::now();
+
+        if (timings)
+        {
+            timings->scan += scan_end_time - scan_start_time;
+            timings->evaluate += evaluate_end_time - scan_end_time;
+        }
+
+        return results;
+    }
+}
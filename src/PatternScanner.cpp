@@ -18,6 +18,7 @@
 */
 
 #include "PatternScanner.h"
+#include "SimdScanner.h"
 
 #include <mem/pattern.h>
 #include <mem/utils.h>
@@ -28,6 +29,7 @@ constexpr const size_t MAX_SCAN_RESULTS = 1000;
 #include "BackgroundTaskThread.h"
 #include "ParallelFunctions.h"
 
+#include <algorithm>
 #include <mutex>
 #include <atomic>
 
@@ -92,8 +94,6 @@ void ScanForArrayOfBytesInternal(Ref<BackgroundTask> task, Ref<BinaryView> view,
         return;
     }
 
-    mem::default_scanner scanner(pattern);
-
     std::vector<uint64_t> results;
 
     size_t total_size {0};
@@ -102,7 +102,10 @@ void ScanForArrayOfBytesInternal(Ref<BackgroundTask> task, Ref<BinaryView> view,
 
     const auto total_start_time = stopwatch::now();
 
-    brick::view_data view_data (view);
+    std::shared_ptr<const brick::view_data> view_data = brick::get_view_data(view);
+
+    // Anchor on the bytes which are rarest in this view
+    brick::simd_scanner scanner(pattern, &view_data->histogram());
 
     for (size_t i = 0; i < SCAN_RUNS; ++i)
     {
@@ -116,12 +119,12 @@ void ScanForArrayOfBytesInternal(Ref<BackgroundTask> task, Ref<BinaryView> view,
         const auto start_time = stopwatch::now();
         const auto start_clocks = mem::rdtsc();
 
-        std::vector<uint64_t> sub_results = view_data.scan_all(scanner);
+        std::vector<uint64_t> sub_results = view_data->scan_all(scanner, pattern.size());
 
         const auto end_clocks = mem::rdtsc();
         const auto end_time = stopwatch::now();
 
-        for (const auto& seg : view_data.segments)
+        for (const auto& seg : view_data->segments)
         {
             total_size += seg.length;
         }
@@ -249,7 +252,7 @@ extern "C"
     struct BinaryPattern
     {
         mem::pattern Pattern {};
-        mem::default_scanner Scanner {};
+        brick::simd_scanner Scanner {};
     };
 
     BINARYNINJAPLUGIN BinaryPattern* BinaryPattern_Parse(const char* pattern)
@@ -257,7 +260,7 @@ extern "C"
         BinaryPattern* result = new BinaryPattern();
 
         result->Pattern = mem::pattern(pattern);
-        result->Scanner = mem::default_scanner(result->Pattern);
+        result->Scanner = brick::simd_scanner(result->Pattern);
 
         return result;
     }
@@ -282,4 +285,193 @@ extern "C"
 
         return total;
     }
+
+    BINARYNINJAPLUGIN uint64_t* BinaryPattern_ScanView(BinaryPattern* pattern, BNBinaryView* view, size_t* count)
+    {
+        Ref<BinaryView> binary_view = new BinaryView(BNNewViewReference(view));
+
+        std::shared_ptr<const brick::view_data> view_data = brick::get_view_data(binary_view);
+
+        brick::simd_scanner scanner(pattern->Pattern, &view_data->histogram());
+
+        std::vector<uint64_t> results = view_data->scan_all(scanner, pattern->Pattern.size());
+
+        uint64_t* addresses = new uint64_t[results.size()];
+
+        std::copy(results.begin(), results.end(), addresses);
+
+        *count = results.size();
+
+        return addresses;
+    }
+
+    BINARYNINJAPLUGIN void BinaryPattern_FreeAddresses(uint64_t* addresses)
+    {
+        delete[] addresses;
+    }
+
+    struct BinaryPatternScan
+    {
+        const BinaryPattern* Pattern {nullptr};
+
+        const uint8_t* Data {nullptr};
+        size_t Length {0};
+
+        // Added to every offset returned
+        size_t Base {0};
+
+        // Offset to continue scanning from
+        size_t Position {0};
+    };
+
+    BINARYNINJAPLUGIN BinaryPatternScan* BinaryPattern_ScanBegin(
+        BinaryPattern* pattern, const uint8_t* data, size_t length, size_t base)
+    {
+        BinaryPatternScan* result = new BinaryPatternScan();
+
+        result->Pattern = pattern;
+        result->Data = data;
+        result->Length = length;
+        result->Base = base;
+
+        return result;
+    }
+
+    BINARYNINJAPLUGIN size_t BinaryPattern_ScanNext(BinaryPatternScan* scan, size_t* values, size_t limit)
+    {
+        const uint8_t* const end = scan->Data + scan->Length;
+        const uint8_t* current = scan->Data + scan->Position;
+
+        size_t total = 0;
+
+        while (total < limit)
+        {
+            const uint8_t* result = scan->Pattern->Scanner.find(current, end);
+
+            if (!result)
+            {
+                current = end;
+
+                break;
+            }
+
+            values[total++] = scan->Base + static_cast<size_t>(result - scan->Data);
+
+            current = result + 1;
+        }
+
+        scan->Position = static_cast<size_t>(current - scan->Data);
+
+        return total;
+    }
+
+    BINARYNINJAPLUGIN void BinaryPattern_ScanEnd(BinaryPatternScan* scan)
+    {
+        delete scan;
+    }
+
+    BINARYNINJAPLUGIN size_t BinaryPattern_ScanCallback(BinaryPattern* pattern, const uint8_t* data, size_t length,
+        size_t base, BinaryPatternCallback callback, void* context, size_t batch_size)
+    {
+        std::vector<size_t> values(std::max<size_t>(batch_size, 1));
+
+        size_t total = 0;
+        size_t count = 0;
+        bool stopped = false;
+
+        pattern->Scanner({data, length}, [&] (mem::pointer p)
+        {
+            values[count++] = base + static_cast<size_t>(p - data);
+
+            if (count == values.size())
+            {
+                total += count;
+                count = 0;
+
+                stopped = callback(context, values.data(), values.size());
+            }
+
+            return stopped;
+        });
+
+        if (count && !stopped)
+        {
+            total += count;
+
+            callback(context, values.data(), count);
+        }
+
+        return total;
+    }
+
+    struct BinaryPatternSet
+    {
+        brick::pattern_set Patterns;
+
+        // The id of each pattern in the set, since malformed patterns are left out
+        std::vector<size_t> Ids;
+    };
+
+    BINARYNINJAPLUGIN BinaryPatternSet* BinaryPatternSet_Create(const char* const* patterns, size_t count)
+    {
+        BinaryPatternSet* result = new BinaryPatternSet();
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            mem::pattern pattern(patterns[i]);
+
+            if (pattern)
+            {
+                result->Patterns.add(pattern);
+                result->Ids.push_back(i);
+            }
+        }
+
+        result->Patterns.compile();
+
+        return result;
+    }
+
+    BINARYNINJAPLUGIN void BinaryPatternSet_Free(BinaryPatternSet* set)
+    {
+        delete set;
+    }
+
+    BINARYNINJAPLUGIN BinaryPatternMatch* BinaryPatternSet_Scan(
+        BinaryPatternSet* set, const uint8_t* data, size_t length, size_t* count)
+    {
+        // Borrow the buffer as a single segment at address 0, so it is scanned on all threads
+        brick::view_data buffer;
+
+        buffer.segments.emplace_back(0, length, data);
+
+        brick::pattern_set_results results = buffer.scan_all(set->Patterns);
+
+        const size_t total = results.addresses.size();
+
+        BinaryPatternMatch* matches = new BinaryPatternMatch[total];
+        BinaryPatternMatch* current = matches;
+
+        for (size_t i = 0; i < set->Ids.size(); ++i)
+        {
+            for (size_t j = results.offsets[i]; j != results.offsets[i + 1]; ++j)
+            {
+                *current++ = { set->Ids[i], static_cast<size_t>(results.addresses[j]) };
+            }
+        }
+
+        std::sort(matches, matches + total, [ ] (const BinaryPatternMatch& lhs, const BinaryPatternMatch& rhs)
+        {
+            return (lhs.Offset != rhs.Offset) ? (lhs.Offset < rhs.Offset) : (lhs.Id < rhs.Id);
+        });
+
+        *count = total;
+
+        return matches;
+    }
+
+    BINARYNINJAPLUGIN void BinaryPatternSet_FreeMatches(BinaryPatternMatch* matches)
+    {
+        delete[] matches;
+    }
 }
@@ -0,0 +1,176 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "PatternSet.h"
+
+#include <algorithm>
+
+namespace brick
+{
+    pattern_set::pattern_set(const mem::byte* bytes, const mem::byte* masks)
+        : external_bytes_(bytes)
+        , external_masks_(masks)
+    { }
+
+    size_t pattern_set::add(const mem::pattern& pattern)
+    {
+        return add(pattern.bytes(), pattern.masks(), pattern.size());
+    }
+
+    size_t pattern_set::add(const mem::byte* bytes, const mem::byte* masks, size_t size)
+    {
+        const size_t offset = bytes_.size();
+
+        bytes_.insert(bytes_.end(), bytes, bytes + size);
+        masks_.insert(masks_.end(), masks, masks + size);
+
+        return add_entry(offset, size, bytes, masks);
+    }
+
+    size_t pattern_set::add_external(size_t offset, size_t size)
+    {
+        return add_entry(offset, size, external_bytes_ + offset, external_masks_ + offset);
+    }
+
+    void pattern_set::reserve(size_t count)
+    {
+        entries_.reserve(count);
+    }
+
+    size_t pattern_set::add_entry(size_t offset, size_t size, const mem::byte* bytes, const mem::byte* masks)
+    {
+        entry e;
+
+        e.offset = offset;
+        e.size = size;
+
+        // Anchor on the start of the longest run of literal bytes
+        for (size_t i = 0; i < e.size;)
+        {
+            if (masks[i] != 0xFF)
+            {
+                ++i;
+
+                continue;
+            }
+
+            size_t j = i;
+
+            while ((j < e.size) && (masks[j] == 0xFF))
+                ++j;
+
+            if ((j - i) > e.anchor_size)
+            {
+                e.anchor_offset = i;
+                e.anchor_size = j - i;
+            }
+
+            i = j;
+        }
+
+        e.anchor_size = std::min<size_t>(e.anchor_size, 4);
+
+        for (size_t i = 0; i < e.anchor_size; ++i)
+        {
+            e.anchor_value |= uint32_t(bytes[e.anchor_offset + i]) << (i * 8);
+            e.anchor_mask |= uint32_t(0xFF) << (i * 8);
+        }
+
+        max_size_ = std::max<size_t>(max_size_, e.size);
+
+        entries_.push_back(e);
+
+        return entries_.size() - 1;
+    }
+
+    void pattern_set::compile()
+    {
+        size_t count4 = 0;
+
+        for (const entry& e : entries_)
+        {
+            if (e.anchor_size == 4)
+                ++count4;
+        }
+
+        uint32_t hash_bits = 8;
+
+        while ((hash_bits < 20) && ((size_t(1) << hash_bits) < (count4 * 2)))
+            ++hash_bits;
+
+        hash_shift_ = 32 - hash_bits;
+
+        const auto build = [this] (std::vector<uint32_t>& buckets, std::vector<uint32_t>& items, size_t bucket_count,
+            size_t anchor_min, size_t anchor_max, uint32_t (*key)(uint32_t value, uint32_t shift))
+        {
+            buckets.assign(bucket_count + 1, 0);
+            items.clear();
+
+            for (const entry& e : entries_)
+            {
+                if ((e.anchor_size >= anchor_min) && (e.anchor_size <= anchor_max))
+                    ++buckets[key(e.anchor_value, hash_shift_) + 1];
+            }
+
+            for (size_t i = 0; i < bucket_count; ++i)
+                buckets[i + 1] += buckets[i];
+
+            if (buckets[bucket_count] == 0)
+            {
+                buckets.clear();
+
+                return;
+            }
+
+            items.resize(buckets[bucket_count]);
+
+            std::vector<uint32_t> cursors(buckets.begin(), buckets.end() - 1);
+
+            for (size_t i = 0; i < entries_.size(); ++i)
+            {
+                const entry& e = entries_[i];
+
+                if ((e.anchor_size >= anchor_min) && (e.anchor_size <= anchor_max))
+                    items[cursors[key(e.anchor_value, hash_shift_)]++] = static_cast<uint32_t>(i);
+            }
+        };
+
+        build(buckets4_, items4_, size_t(1) << hash_bits, 4, 4, &hash);
+        build(buckets2_, items2_, 0x10000, 2, 3, [ ] (uint32_t value, uint32_t) -> uint32_t { return value & 0xFFFF; });
+        build(buckets1_, items1_, 0x100, 1, 1, [ ] (uint32_t value, uint32_t) -> uint32_t { return value & 0xFF; });
+
+        unanchored_.clear();
+
+        for (size_t i = 0; i < entries_.size(); ++i)
+        {
+            if (entries_[i].anchor_size == 0)
+                unanchored_.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    size_t pattern_set::size() const
+    {
+        return entries_.size();
+    }
+
+    size_t pattern_set::max_pattern_size() const
+    {
+        return max_size_;
+    }
+}
@@ -0,0 +1,315 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "SimdScanner.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#    define BRICK_SIMD_X86
+#    include <immintrin.h>
+#    if defined(_MSC_VER)
+#        include <intrin.h>
+#    endif
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#    define BRICK_TARGET_AVX2
+#else
+#    define BRICK_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace brick
+{
+    // Rough frequency of common bytes in executables, used to avoid picking them as anchors when there is no histogram
+    static uint64_t GetByteWeight(mem::byte value)
+    {
+        switch (value)
+        {
+            case 0x00: return 8;
+            case 0xFF: return 6;
+            case 0xCC: case 0x90: case 0x48: case 0x8B: return 5;
+            case 0x89: case 0x0F: case 0xE8: return 4;
+            case 0x4C: case 0x83: case 0x24: case 0x44: case 0x85: case 0x8D: case 0x01: case 0xC3: return 3;
+            case 0x74: case 0x75: case 0x45: case 0x40: case 0x20: case 0xC0: case 0x10: case 0x08: return 2;
+            default: return 1;
+        }
+    }
+
+#if defined(BRICK_SIMD_X86)
+    static unsigned CountTrailingZeros(uint32_t value)
+    {
+#    if defined(_MSC_VER) && !defined(__clang__)
+        unsigned long index = 0;
+        _BitScanForward(&index, value);
+        return index;
+#    else
+        return __builtin_ctz(value);
+#    endif
+    }
+
+    static bool HasAVX2()
+    {
+#    if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+
+        __cpuid(info, 0);
+
+        if (info[0] < 7)
+            return false;
+
+        __cpuid(info, 1);
+
+        // The OS has to save the AVX registers as well
+        if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || ((_xgetbv(0) & 6) != 6))
+            return false;
+
+        __cpuidex(info, 7, 0);
+
+        return (info[1] & (1 << 5)) != 0;
+#    else
+        return __builtin_cpu_supports("avx2");
+#    endif
+    }
+#endif
+
+    simd_scanner::simd_scanner(const mem::pattern& pattern, const byte_histogram* histogram)
+        : bytes_(pattern.bytes(), pattern.bytes() + pattern.size())
+        , masks_(pattern.masks(), pattern.masks() + pattern.size())
+    {
+        const size_t size = bytes_.size();
+
+        if (size == 0)
+        {
+            return;
+        }
+
+        const auto get_weight = [histogram] (mem::byte value) -> uint64_t
+        {
+            return histogram ? (*histogram)[value] : GetByteWeight(value);
+        };
+
+        size_t anchor1 = SIZE_MAX;
+        size_t anchor2 = SIZE_MAX;
+        uint64_t best_weight = 0;
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (masks_[i] != 0xFF)
+                continue;
+
+            const uint64_t weight = get_weight(bytes_[i]);
+
+            if ((anchor1 == SIZE_MAX) || (weight < best_weight))
+            {
+                anchor1 = i;
+                best_weight = weight;
+            }
+        }
+
+        if (anchor1 == SIZE_MAX)
+        {
+            find_ = &find_unanchored;
+
+            return;
+        }
+
+        // A second anchor with the same value filters out less, so it is only used if there is nothing else
+        bool best_same = false;
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            if ((masks_[i] != 0xFF) || (i == anchor1))
+                continue;
+
+            const uint64_t weight = get_weight(bytes_[i]);
+            const bool same = bytes_[i] == bytes_[anchor1];
+
+            if ((anchor2 == SIZE_MAX) || (same < best_same) || ((same == best_same) && (weight < best_weight)))
+            {
+                anchor2 = i;
+                best_weight = weight;
+                best_same = same;
+            }
+        }
+
+        anchor1_ = anchor1;
+        anchor2_ = (anchor2 != SIZE_MAX) ? anchor2 : anchor1;
+
+        static const find_function find_anchored = [ ] () -> find_function
+        {
+#if defined(BRICK_SIMD_X86)
+            if (HasAVX2())
+                return &find_avx2;
+
+            return &find_sse2;
+#else
+            return &find_scalar;
+#endif
+        }();
+
+        find_ = find_anchored;
+    }
+
+    bool simd_scanner::use_kernel(kernel value)
+    {
+        find_function find = nullptr;
+
+        switch (value)
+        {
+            case kernel::scalar:
+                find = &find_scalar;
+                break;
+
+#if defined(BRICK_SIMD_X86)
+            case kernel::sse2:
+                find = &find_sse2;
+                break;
+
+            case kernel::avx2:
+                if (HasAVX2())
+                    find = &find_avx2;
+                break;
+#endif
+
+            default:
+                break;
+        }
+
+        if (!find)
+            return false;
+
+        if (find_ && (find_ != &find_unanchored))
+            find_ = find;
+
+        return true;
+    }
+
+    const mem::byte* simd_scanner::find_unanchored(const simd_scanner& scanner, const mem::byte* start, const mem::byte* end)
+    {
+        const size_t size = scanner.bytes_.size();
+
+        if (size_t(end - start) < size)
+            return nullptr;
+
+        for (const mem::byte *current = start, *last = end - size; current <= last; ++current)
+        {
+            if (scanner.verify(current))
+                return current;
+        }
+
+        return nullptr;
+    }
+
+    const mem::byte* simd_scanner::find_scalar(const simd_scanner& scanner, const mem::byte* start, const mem::byte* end)
+    {
+        const size_t size = scanner.bytes_.size();
+
+        if (size_t(end - start) < size)
+            return nullptr;
+
+        const size_t anchor = scanner.anchor1_;
+        const mem::byte value = scanner.bytes_[anchor];
+
+        for (const mem::byte *current = start, *last = end - size; current <= last; ++current)
+        {
+            const void* found = std::memchr(current + anchor, value, size_t(last - current) + 1);
+
+            if (!found)
+                break;
+
+            current = static_cast<const mem::byte*>(found) - anchor;
+
+            if (scanner.verify(current))
+                return current;
+        }
+
+        return nullptr;
+    }
+
+#if defined(BRICK_SIMD_X86)
+    const mem::byte* simd_scanner::find_sse2(const simd_scanner& scanner, const mem::byte* start, const mem::byte* end)
+    {
+        const size_t size = scanner.bytes_.size();
+
+        if (size_t(end - start) < size)
+            return nullptr;
+
+        const size_t anchor1 = scanner.anchor1_;
+        const size_t anchor2 = scanner.anchor2_;
+
+        const __m128i value1 = _mm_set1_epi8(static_cast<char>(scanner.bytes_[anchor1]));
+        const __m128i value2 = _mm_set1_epi8(static_cast<char>(scanner.bytes_[anchor2]));
+
+        const mem::byte* current = start;
+        const mem::byte* const last = end - size;
+
+        // Every candidate in the block must be a valid position, which also keeps the anchor loads in bounds
+        for (; (last - current) >= 15; current += 16)
+        {
+            const __m128i match1 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(current + anchor1)), value1);
+            const __m128i match2 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(current + anchor2)), value2);
+
+            for (uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(match1, match2))); mask; mask &= mask - 1)
+            {
+                const mem::byte* candidate = current + CountTrailingZeros(mask);
+
+                if (scanner.verify(candidate))
+                    return candidate;
+            }
+        }
+
+        return find_scalar(scanner, current, end);
+    }
+
+    BRICK_TARGET_AVX2
+    const mem::byte* simd_scanner::find_avx2(const simd_scanner& scanner, const mem::byte* start, const mem::byte* end)
+    {
+        const size_t size = scanner.bytes_.size();
+
+        if (size_t(end - start) < size)
+            return nullptr;
+
+        const size_t anchor1 = scanner.anchor1_;
+        const size_t anchor2 = scanner.anchor2_;
+
+        const __m256i value1 = _mm256_set1_epi8(static_cast<char>(scanner.bytes_[anchor1]));
+        const __m256i value2 = _mm256_set1_epi8(static_cast<char>(scanner.bytes_[anchor2]));
+
+        const mem::byte* current = start;
+        const mem::byte* const last = end - size;
+
+        for (; (last - current) >= 31; current += 32)
+        {
+            const __m256i match1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(current + anchor1)), value1);
+            const __m256i match2 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(current + anchor2)), value2);
+
+            for (uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(match1, match2))); mask; mask &= mask - 1)
+            {
+                const mem::byte* candidate = current + CountTrailingZeros(mask);
+
+                if (scanner.verify(candidate))
+                    return candidate;
+            }
+        }
+
+        return find_sse2(scanner, current, end);
+    }
+#endif
+}
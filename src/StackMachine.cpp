@@ -0,0 +1,722 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "StackMachine.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <stack>
+
+#include <mem/utils.h>
+
+namespace mem
+{
+    namespace sm
+    {
+        struct token
+        {
+            opcode op {op_invalid};
+            size_t operand_count {0};
+            std::array<size_t, 1> operands {};
+
+            token(opcode op, size_t operand_count = 0, const std::initializer_list<size_t>& operands = {});
+        };
+
+        token::token(opcode op_, size_t operand_count_, const std::initializer_list<size_t>& operands_)
+            : op(op_)
+            , operand_count(operand_count_)
+        {
+            std::copy(operands_.begin(), operands_.end(), operands.begin());
+        }
+
+        size_t get_precedence(opcode op)
+        {
+            switch (op)
+            {
+                case op_mul: case op_div: case op_mod:
+                    return 6;
+
+                case op_add: case op_sub:
+                    return 5;
+
+                case op_and:
+                    return 4;
+
+                case op_xor:
+                    return 3;
+
+                case op_or:
+                    return 2;
+
+                case op_paren:
+                    return 0;
+
+                default:
+                    return 1;
+            }
+        }
+
+        void push_code(std::vector<size_t>& code, const token& token)
+        {
+            code.push_back(token.op);
+
+            for (size_t i = 0; i < token.operand_count; ++i)
+                code.push_back(token.operands[i]);
+        }
+
+        void push_token(std::vector<size_t>& code, std::stack<token>& pending, const token& new_token)
+        {
+            if (new_token.op != op_paren)
+            {
+                size_t precedence = get_precedence(new_token.op);
+
+                while (!pending.empty())
+                {
+                    const token& current = pending.top();
+                    size_t current_precedence = get_precedence(current.op);
+
+                    if (precedence > current_precedence)
+                    {
+                        break;
+                    }
+
+                    push_code(code, current);
+
+                    pending.pop();
+
+                    if (precedence == current_precedence)
+                    {
+                        break;
+                    }
+                }
+            }
+
+            pending.push(new_token);
+        }
+
+        bool match_parens(std::vector<size_t>& code, std::stack<token>& pending, paren_type type)
+        {
+            while (!pending.empty())
+            {
+                token current = pending.top(); pending.pop();
+
+                if (current.op == op_paren)
+                {
+                    return (current.operand_count == 1 && current.operands[0] == type);
+                }
+
+                push_code(code, current);
+            }
+
+            return false;
+        }
+
+        bool compile_infix(const char* string, std::vector<size_t>& code)
+        {
+            code.clear();
+
+            std::stack<token> pending;
+
+            char_queue input(string);
+
+            while (input)
+            {
+                int current = input.peek();
+
+                if (current == ' ') { input.pop(); }
+                else if (current == '+') { input.pop(); push_token(code, pending, { op_add }); }
+                else if (current == '-') { input.pop(); push_token(code, pending, { op_sub }); }
+                else if (current == '*') { input.pop(); push_token(code, pending, { op_mul }); }
+                else if (current == '/') { input.pop(); push_token(code, pending, { op_div }); }
+                else if (current == '%') { input.pop(); push_token(code, pending, { op_mod }); }
+                else if (current == '&') { input.pop(); push_token(code, pending, { op_and }); }
+                else if (current == '|') { input.pop(); push_token(code, pending, { op_or  }); }
+                else if (current == '^') { input.pop(); push_token(code, pending, { op_xor }); }
+                else if (current == '(')
+                {
+                    input.pop();
+
+                    push_token(code, pending, { op_paren, 1, { paren_default }});
+                }
+                else if (current == ')')
+                {
+                    input.pop();
+
+                    if (!match_parens(code, pending, paren_default))
+                    {
+                        return false;
+                    }
+                }
+                else if (current == '[')
+                {
+                    input.pop();
+
+                    push_token(code, pending, { op_paren, 1, { paren_bracket }});
+                }
+                else if (current == ']')
+                {
+                    input.pop();
+
+                    if (!match_parens(code, pending, paren_bracket))
+                    {
+                        return false;
+                    }
+
+                    size_t read_size = 0;
+                    bool is_signed = false;
+                    bool is_relative = false;
+
+                    if (input.peek() == '.')
+                    {
+                        input.pop();
+
+                        if (input.peek() == 'r')
+                        {
+                            input.pop();
+
+                            is_relative = true;
+                        }
+
+                        if (input.peek() == 's')
+                        {
+                            input.pop();
+
+                            is_signed = true;
+                        }
+
+                        current = input.peek();
+
+                        if      (current == 'b') { input.pop(); read_size = 1; }
+                        else if (current == 'w') { input.pop(); read_size = 2; }
+                        else if (current == 'd') { input.pop(); read_size = 4; }
+                        else if (current == 'q') { input.pop(); read_size = 8; }
+                        else if (is_relative)
+                        {
+                            read_size = 4;
+
+                            is_signed = true;
+                        }
+                        else
+                        {
+                            return false;
+                        }
+                    }
+
+                    if (is_relative)
+                    {
+                        push_code(code, { op_dup });
+                    }
+
+                    push_code(code, { op_load, 1, { read_size }});
+
+                    if (is_signed)
+                    {
+                        push_code(code, { op_sx, 1, { read_size * 8 }});
+                    }
+
+                    if (is_relative)
+                    {
+                        push_code(code, { op_add });
+                    }
+                }
+                else if (current == '$')
+                {
+                    input.pop();
+
+                    char name[64 + 1];
+                    size_t name_length = 0;
+
+                    while (input)
+                    {
+                        current = input.peek();
+
+                        if (!std::isalnum(current) && (current != '_'))
+                            break;
+
+                        if (name_length + 1 > 64)
+                            return false;
+
+                        name[name_length++] = (char) current;
+
+                        input.pop();
+                    }
+
+                    name[name_length++] = '\0';
+
+                    size_t sym = SIZE_MAX;
+
+                    if (!std::strcmp(name, "") || !std::strcmp(name, "here"))
+                    {
+                        sym = sym_here;
+                    }
+                    else
+                    {
+                        return false;
+                    }
+
+                    push_code(code, { op_sym, 1, { sym }});
+                }
+                else if (xctoi(current) != -1)
+                {
+                    int temp = -1;
+
+                    size_t value = 0;
+
+                    while ((temp = xctoi(input.peek())) != -1)
+                    {
+                        input.pop();
+
+                        value = (value * 16) + temp;
+                    }
+
+                    push_code(code, { op_push, 1, { value }});
+                }
+                else
+                {
+                    return false;
+                }
+            }
+
+            while (!pending.empty())
+            {
+                token current = pending.top(); pending.pop();
+
+                if (current.op == op_paren)
+                    return false;
+
+                push_code(code, current);
+            }
+
+            return true;
+        }
+
+        bool compile_postfix(const char* string, std::vector<size_t>& code)
+        {
+            code.clear();
+
+            char_queue input(string);
+
+            while (input)
+            {
+                int current = input.peek();
+
+                if (current == ' ') { input.pop(); }
+                else if (current == '+') { input.pop(); code.push_back(op_add);  }
+                else if (current == '-') { input.pop(); code.push_back(op_sub);  }
+                else if (current == '*') { input.pop(); code.push_back(op_mul);  }
+                else if (current == '/') { input.pop(); code.push_back(op_div);  }
+                else if (current == '%') { input.pop(); code.push_back(op_mod);  }
+                else if (current == '&') { input.pop(); code.push_back(op_and);  }
+                else if (current == '|') { input.pop(); code.push_back(op_or );  }
+                else if (current == '^') { input.pop(); code.push_back(op_xor);  }
+                else if (current == '>') { input.pop(); code.push_back(op_dup);  }
+                else if (current == '<') { input.pop(); code.push_back(op_drop); }
+                else if (current == '[')
+                {
+                    input.pop();
+
+                    bool is_signed = false;
+                    size_t width = SIZE_MAX;
+
+                    if      (input.peek() == 's') { input.pop(); is_signed = true;  }
+                    else if (input.peek() == 'u') { input.pop(); is_signed = false; }
+
+                    if      (input.peek() == 'b') { input.pop(); width = 1; }
+                    else if (input.peek() == 'w') { input.pop(); width = 2; }
+                    else if (input.peek() == 'd') { input.pop(); width = 4; }
+                    else if (input.peek() == 'q') { input.pop(); width = 8; }
+                    else
+                    {
+                        return false;
+                    }
+
+                    if (width > sizeof(size_t))
+                        return false;
+
+                    if (input.peek() != ']')
+                        return false;
+
+                    input.pop();
+
+                    code.push_back(op_load);
+                    code.push_back(width);
+
+                    if (is_signed)
+                    {
+                        code.push_back(op_sx);
+                        code.push_back(width * 8);
+                    }
+                }
+                else if (current == '$')
+                {
+                    input.pop();
+
+                    char name[64 + 1];
+                    size_t name_length = 0;
+
+                    while (input)
+                    {
+                        current = input.peek();
+
+                        if (!std::isalnum(current) && (current != '_'))
+                            break;
+
+                        if (name_length + 1 > 64)
+                            return false;
+
+                        name[name_length++] = (char) current;
+
+                        input.pop();
+                    }
+
+                    name[name_length++] = '\0';
+
+                    size_t sym = SIZE_MAX;
+
+                    if (!std::strcmp(name, "") || !std::strcmp(name, "here")) { sym = sym_here; }
+                    else { return false; }
+
+                    code.push_back(op_sym);
+                    code.push_back(sym);
+                }
+                else if (xctoi(current) != -1)
+                {
+                    int temp = -1;
+
+                    size_t value = 0;
+
+                    while ((temp = mem::xctoi(input.peek())) != -1)
+                    {
+                        input.pop();
+
+                        value = (value * 16) + temp;
+                    }
+
+                    code.push_back(op_push);
+                    code.push_back(value);
+                }
+                else
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        struct instruction
+        {
+            size_t op {op_invalid};
+            std::array<size_t, 2> operands {};
+
+            instruction(size_t op = op_invalid, size_t operand0 = 0, size_t operand1 = 0);
+        };
+
+        instruction::instruction(size_t op_, size_t operand0, size_t operand1)
+            : op(op_)
+            , operands {{ operand0, operand1 }}
+        { }
+
+        // Returns SIZE_MAX for unknown opcodes
+        size_t get_operand_count(size_t op)
+        {
+            switch (op)
+            {
+                case op_add: case op_sub: case op_mul: case op_div: case op_mod:
+                case op_and: case op_or: case op_xor: case op_neg: case op_dup: case op_drop:
+                    return 0;
+
+                case op_push: case op_sx: case op_load: case op_sym:
+                    return 1;
+
+                case op_sym_add: case op_load_rel:
+                    return 2;
+
+                default:
+                    return SIZE_MAX;
+            }
+        }
+
+        bool is_binary(size_t op)
+        {
+            switch (op)
+            {
+                case op_add: case op_sub: case op_mul: case op_div: case op_mod:
+                case op_and: case op_or: case op_xor:
+                    return true;
+
+                default:
+                    return false;
+            }
+        }
+
+        bool fold_binary(size_t op, size_t lhs, size_t rhs, size_t& out)
+        {
+            switch (op)
+            {
+                case op_add: out = lhs + rhs; return true;
+                case op_sub: out = lhs - rhs; return true;
+                case op_mul: out = lhs * rhs; return true;
+                case op_and: out = lhs & rhs; return true;
+                case op_or:  out = lhs | rhs; return true;
+                case op_xor: out = lhs ^ rhs; return true;
+
+                // Division by zero is left to fail at runtime
+                case op_div: if (rhs == 0) { return false; } out = lhs / rhs; return true;
+                case op_mod: if (rhs == 0) { return false; } out = lhs % rhs; return true;
+            }
+
+            return false;
+        }
+
+        size_t sign_extend(size_t value, size_t bits)
+        {
+            size_t mask = size_t(1) << (bits - 1);
+
+            return (value ^ mask) - mask;
+        }
+
+        bool optimize_at(std::vector<instruction>& insns, size_t i)
+        {
+            const auto is = [&] (size_t offset, size_t op) -> bool
+            {
+                return (i + offset < insns.size()) && (insns[i + offset].op == op);
+            };
+
+            const auto replace = [&] (size_t count, const instruction& insn)
+            {
+                insns[i] = insn;
+                insns.erase(insns.begin() + i + 1, insns.begin() + i + count);
+            };
+
+            // push a, push b, op => push (a op b)
+            if (is(0, op_push) && is(1, op_push) && (i + 2 < insns.size()) && is_binary(insns[i + 2].op))
+            {
+                size_t value = 0;
+
+                if (fold_binary(insns[i + 2].op, insns[i].operands[0], insns[i + 1].operands[0], value))
+                {
+                    replace(3, instruction(op_push, value));
+
+                    return true;
+                }
+            }
+
+            // push a, neg => push -a
+            if (is(0, op_push) && is(1, op_neg))
+            {
+                replace(2, instruction(op_push, size_t(0) - insns[i].operands[0]));
+
+                return true;
+            }
+
+            // push a, sx n => push sx(a, n)
+            if (is(0, op_push) && is(1, op_sx))
+            {
+                replace(2, instruction(op_push, sign_extend(insns[i].operands[0], insns[i + 1].operands[0])));
+
+                return true;
+            }
+
+            // sym s, push a, add/sub => sym_add s, +/-a
+            if (is(0, op_sym) && is(1, op_push) && (is(2, op_add) || is(2, op_sub)))
+            {
+                size_t value = insns[i + 1].operands[0];
+
+                if (is(2, op_sub))
+                    value = size_t(0) - value;
+
+                replace(3, instruction(op_sym_add, insns[i].operands[0], value));
+
+                return true;
+            }
+
+            // sym_add s a, push b, add/sub => sym_add s, a +/- b
+            if (is(0, op_sym_add) && is(1, op_push) && (is(2, op_add) || is(2, op_sub)))
+            {
+                size_t value = insns[i + 1].operands[0];
+
+                if (is(2, op_sub))
+                    value = size_t(0) - value;
+
+                replace(3, instruction(op_sym_add, insns[i].operands[0], insns[i].operands[1] + value));
+
+                return true;
+            }
+
+            // dup, load n, sx b, add => load_rel n, b (e.g [$ + 3].r)
+            if (is(0, op_dup) && is(1, op_load) && is(2, op_sx) && is(3, op_add))
+            {
+                replace(4, instruction(op_load_rel, insns[i + 1].operands[0], insns[i + 2].operands[0]));
+
+                return true;
+            }
+
+            // dup, load n, add => load_rel n, 0
+            if (is(0, op_dup) && is(1, op_load) && is(2, op_add))
+            {
+                replace(3, instruction(op_load_rel, insns[i + 1].operands[0], 0));
+
+                return true;
+            }
+
+            return false;
+        }
+
+        bool verify(const size_t* code, size_t length, size_t& max_stack)
+        {
+            size_t depth = 0;
+            size_t max_depth = 0;
+
+            for (size_t ip = 0; ip < length;)
+            {
+                const size_t op = code[ip++];
+                const size_t operand_count = get_operand_count(op);
+
+                if ((operand_count == SIZE_MAX) || (operand_count > length - ip))
+                    return false;
+
+                const size_t* operands = &code[ip];
+
+                ip += operand_count;
+
+                size_t pops = 0;
+                size_t pushes = 0;
+
+                switch (op)
+                {
+                    case op_push: case op_sym: case op_sym_add:
+                        pushes = 1; break;
+
+                    case op_sx:
+                    {
+                        if ((operands[0] == 0) || (operands[0] > sizeof(size_t) * 8))
+                            return false;
+
+                        pops = 1; pushes = 1;
+                    } break;
+
+                    case op_load:
+                    {
+                        if (operands[0] > sizeof(size_t))
+                            return false;
+
+                        pops = 1; pushes = 1;
+                    } break;
+
+                    case op_load_rel:
+                    {
+                        if ((operands[0] > sizeof(size_t)) || (operands[1] > sizeof(size_t) * 8))
+                            return false;
+
+                        pops = 1; pushes = 1;
+                    } break;
+
+                    case op_neg:
+                        pops = 1; pushes = 1; break;
+
+                    case op_dup:
+                        pops = 1; pushes = 2; break;
+
+                    case op_drop:
+                        pops = 1; break;
+
+                    default:
+                        pops = 2; pushes = 1; break;
+                }
+
+                if (depth < pops)
+                    return false;
+
+                depth = depth - pops + pushes;
+                max_depth = std::max(max_depth, depth);
+            }
+
+            if ((depth != 1) || (max_depth > max_stack_size))
+                return false;
+
+            max_stack = max_depth;
+
+            return true;
+        }
+
+        bool link(const std::vector<size_t>& code, program& out)
+        {
+            std::vector<instruction> insns;
+
+            for (size_t ip = 0; ip < code.size();)
+            {
+                instruction insn;
+
+                insn.op = code[ip++];
+
+                const size_t operand_count = get_operand_count(insn.op);
+
+                if ((operand_count == SIZE_MAX) || (operand_count > code.size() - ip))
+                    return false;
+
+                for (size_t i = 0; i < operand_count; ++i)
+                    insn.operands[i] = code[ip++];
+
+                switch (insn.op)
+                {
+                    case op_sx:
+                    {
+                        if ((insn.operands[0] == 0) || (insn.operands[0] > sizeof(size_t) * 8))
+                            return false;
+                    } break;
+
+                    case op_load:
+                    {
+                        // Size 0 reads an address sized integer
+                        if (insn.operands[0] > sizeof(size_t))
+                            return false;
+                    } break;
+                }
+
+                insns.push_back(insn);
+            }
+
+            for (bool changed = true; changed;)
+            {
+                changed = false;
+
+                for (size_t i = 0; i < insns.size(); ++i)
+                {
+                    while (optimize_at(insns, i))
+                        changed = true;
+                }
+            }
+
+            out.code.clear();
+
+            for (const instruction& insn : insns)
+            {
+                out.code.push_back(insn.op);
+
+                for (size_t i = 0, count = get_operand_count(insn.op); i < count; ++i)
+                    out.code.push_back(insn.operands[i]);
+            }
+
+            return verify(out.code.data(), out.code.size(), out.max_stack);
+        }
+    }
+}
@@ -0,0 +1,374 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "SuffixIndex.h"
+#include "ParallelFunctions.h"
+#include "SimdScanner.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#include <mem/pattern.h>
+
+namespace brick
+{
+    // Sorts the suffixes of a short string directly
+    template <typename Text>
+    static std::vector<int32_t> SortSuffixesNaive(const Text& s, int32_t n)
+    {
+        std::vector<int32_t> sa(n);
+
+        for (int32_t i = 0; i < n; ++i)
+            sa[i] = i;
+
+        std::sort(sa.begin(), sa.end(), [&] (int32_t l, int32_t r)
+        {
+            while ((l < n) && (r < n))
+            {
+                if (s[l] != s[r])
+                    return s[l] < s[r];
+
+                ++l;
+                ++r;
+            }
+
+            return l == n;
+        });
+
+        return sa;
+    }
+
+    // SA-IS (Nong, Zhang & Chan), s[i] must be in [0, upper]
+    template <typename Text>
+    static std::vector<int32_t> SortSuffixes(const Text& s, int32_t n, int32_t upper)
+    {
+        if (n < 16)
+            return SortSuffixesNaive(s, n);
+
+        std::vector<int32_t> sa(n);
+        std::vector<bool> ls(n);
+
+        for (int32_t i = n - 2; i >= 0; --i)
+            ls[i] = (s[i] == s[i + 1]) ? ls[i + 1] : (s[i] < s[i + 1]);
+
+        std::vector<int32_t> sum_l(upper + 1);
+        std::vector<int32_t> sum_s(upper + 1);
+
+        for (int32_t i = 0; i < n; ++i)
+        {
+            if (!ls[i])
+                ++sum_s[s[i]];
+            else
+                ++sum_l[s[i] + 1];
+        }
+
+        for (int32_t i = 0; i <= upper; ++i)
+        {
+            sum_s[i] += sum_l[i];
+
+            if (i < upper)
+                sum_l[i + 1] += sum_s[i];
+        }
+
+        std::vector<int32_t> buckets(upper + 1);
+
+        const auto induce = [&] (const std::vector<int32_t>& lms)
+        {
+            std::fill(sa.begin(), sa.end(), -1);
+
+            std::copy(sum_s.begin(), sum_s.end(), buckets.begin());
+
+            for (int32_t d : lms)
+            {
+                if (d != n)
+                    sa[buckets[s[d]]++] = d;
+            }
+
+            std::copy(sum_l.begin(), sum_l.end(), buckets.begin());
+
+            sa[buckets[s[n - 1]]++] = n - 1;
+
+            for (int32_t i = 0; i < n; ++i)
+            {
+                int32_t v = sa[i];
+
+                if ((v >= 1) && !ls[v - 1])
+                    sa[buckets[s[v - 1]]++] = v - 1;
+            }
+
+            std::copy(sum_l.begin(), sum_l.end(), buckets.begin());
+
+            for (int32_t i = n - 1; i >= 0; --i)
+            {
+                int32_t v = sa[i];
+
+                if ((v >= 1) && ls[v - 1])
+                    sa[--buckets[s[v - 1] + 1]] = v - 1;
+            }
+        };
+
+        std::vector<int32_t> lms_map(n + 1, -1);
+        std::vector<int32_t> lms;
+
+        for (int32_t i = 1; i < n; ++i)
+        {
+            if (!ls[i - 1] && ls[i])
+            {
+                lms_map[i] = static_cast<int32_t>(lms.size());
+                lms.push_back(i);
+            }
+        }
+
+        const int32_t m = static_cast<int32_t>(lms.size());
+
+        induce(lms);
+
+        if (m)
+        {
+            std::vector<int32_t> sorted_lms;
+
+            sorted_lms.reserve(m);
+
+            for (int32_t v : sa)
+            {
+                if (lms_map[v] != -1)
+                    sorted_lms.push_back(v);
+            }
+
+            std::vector<int32_t> rec_s(m);
+            int32_t rec_upper = 0;
+
+            rec_s[lms_map[sorted_lms[0]]] = 0;
+
+            for (int32_t i = 1; i < m; ++i)
+            {
+                int32_t l = sorted_lms[i - 1];
+                int32_t r = sorted_lms[i];
+
+                const int32_t end_l = (lms_map[l] + 1 < m) ? lms[lms_map[l] + 1] : n;
+                const int32_t end_r = (lms_map[r] + 1 < m) ? lms[lms_map[r] + 1] : n;
+
+                bool same = true;
+
+                if ((end_l - l) != (end_r - r))
+                {
+                    same = false;
+                }
+                else
+                {
+                    while ((l < end_l) && (s[l] == s[r]))
+                    {
+                        ++l;
+                        ++r;
+                    }
+
+                    if ((l == n) || (s[l] != s[r]))
+                        same = false;
+                }
+
+                if (!same)
+                    ++rec_upper;
+
+                rec_s[lms_map[sorted_lms[i]]] = rec_upper;
+            }
+
+            lms_map = std::vector<int32_t>();
+
+            std::vector<int32_t> rec_sa = SortSuffixes(rec_s, m, rec_upper);
+
+            for (int32_t i = 0; i < m; ++i)
+                sorted_lms[i] = lms[rec_sa[i]];
+
+            induce(sorted_lms);
+        }
+
+        return sa;
+    }
+
+    suffix_index::suffix_index(std::shared_ptr<const view_data> data)
+        : data_(std::move(data))
+    {
+        segments_.resize(data_->segments.size());
+
+        for (size_t i = 0; i < segments_.size(); ++i)
+        {
+            segments_[i].segment = &data_->segments[i];
+        }
+
+        parallel_for_each(segments_.begin(), segments_.end(), [ ] (segment_index& index) -> bool
+        {
+            const view_segment& segment = *index.segment;
+
+            if ((segment.length > 0) && (segment.length < INT32_MAX))
+            {
+                index.suffixes = SortSuffixes(segment.data, static_cast<int32_t>(segment.length), UINT8_MAX);
+            }
+
+            return true;
+        });
+    }
+
+    static bool MatchPattern(const uint8_t* data, const mem::pattern& pattern)
+    {
+        const mem::byte* bytes = pattern.bytes();
+        const mem::byte* masks = pattern.masks();
+
+        for (size_t i = 0, size = pattern.size(); i < size; ++i)
+        {
+            if ((data[i] ^ bytes[i]) & masks[i])
+                return false;
+        }
+
+        return true;
+    }
+
+    std::vector<uint64_t> suffix_index::find(const mem::pattern& pattern, size_t limit) const
+    {
+        std::vector<uint64_t> results;
+
+        const size_t size = pattern.size();
+        const mem::byte* bytes = pattern.bytes();
+        const mem::byte* masks = pattern.masks();
+
+        if ((size == 0) || (limit == 0))
+        {
+            return results;
+        }
+
+        struct literal_run
+        {
+            size_t offset;
+            size_t length;
+        };
+
+        std::vector<literal_run> runs;
+
+        for (size_t i = 0; i < size;)
+        {
+            if (masks[i] != 0xFF)
+            {
+                ++i;
+
+                continue;
+            }
+
+            size_t j = i;
+
+            while ((j < size) && (masks[j] == 0xFF))
+                ++j;
+
+            runs.push_back({i, j - i});
+
+            i = j;
+        }
+
+        for (const segment_index& index : segments_)
+        {
+            const view_segment& segment = *index.segment;
+
+            const auto add_result = [&] (size_t offset) -> bool
+            {
+                if ((offset <= segment.length) && (size <= segment.length - offset) && MatchPattern(segment.data + offset, pattern))
+                {
+                    results.push_back(segment.start + offset);
+                }
+
+                return results.size() >= limit;
+            };
+
+            if (index.suffixes.empty() || runs.empty())
+            {
+                bool done = false;
+
+                simd_scanner scanner(pattern, &data_->histogram());
+
+                scanner(mem::region { segment.data, static_cast<size_t>(segment.length) }, [&] (mem::pointer result)
+                {
+                    done = add_result(result.as<const uint8_t*>() - segment.data);
+
+                    return done;
+                });
+
+                if (done)
+                    return results;
+
+                continue;
+            }
+
+            const int32_t* const suffixes = index.suffixes.data();
+            const size_t suffix_count = index.suffixes.size();
+
+            // Narrow down to the literal run with the fewest occurrences, then verify the rest of the pattern
+            const int32_t* best_begin = nullptr;
+            const int32_t* best_end = nullptr;
+            size_t best_offset = 0;
+
+            for (const literal_run& run : runs)
+            {
+                const mem::byte* needle = bytes + run.offset;
+                const size_t needle_length = run.length;
+
+                // Compares the first needle_length bytes of a suffix against the needle
+                const auto compare = [&] (int32_t suffix) -> int
+                {
+                    const size_t available = static_cast<size_t>(segment.length) - static_cast<size_t>(suffix);
+                    const size_t length = std::min(available, needle_length);
+
+                    int result = std::memcmp(segment.data + suffix, needle, length);
+
+                    if ((result == 0) && (length < needle_length))
+                        result = -1;
+
+                    return result;
+                };
+
+                const int32_t* begin = std::partition_point(suffixes, suffixes + suffix_count, [&] (int32_t suffix)
+                {
+                    return compare(suffix) < 0;
+                });
+
+                const int32_t* end = std::partition_point(begin, suffixes + suffix_count, [&] (int32_t suffix)
+                {
+                    return compare(suffix) == 0;
+                });
+
+                if (!best_begin || ((end - begin) < (best_end - best_begin)))
+                {
+                    best_begin = begin;
+                    best_end = end;
+                    best_offset = run.offset;
+                }
+
+                if (begin == end)
+                    break;
+            }
+
+            for (const int32_t* i = best_begin; i != best_end; ++i)
+            {
+                const size_t offset = static_cast<size_t>(*i);
+
+                if ((offset >= best_offset) && add_result(offset - best_offset))
+                    return results;
+            }
+        }
+
+        return results;
+    }
+}
@@ -0,0 +1,147 @@
+/*
+    Copyright 2018 Brick
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+    and associated documentation files (the "Software"), to deal in the Software without restriction,
+    including without limitation the rights to use, copy, modify, merge, publish, distribute,
+    sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in all copies or
+    substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+    BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+    DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+    OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ViewData.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace brick
+{
+    view_segment::view_segment(uint64_t start_, uint64_t length_, const uint8_t* data_)
+        : start(start_)
+        , length(length_)
+        , data(data_)
+    { }
+
+    view_segment::view_segment(uint64_t start_, uint64_t length_, std::unique_ptr<uint8_t[ ]> buffer_)
+        : start(start_)
+        , length(length_)
+        , data(buffer_.get())
+        , buffer(std::move(buffer_))
+    { }
+
+    const uint8_t* view_data::find(uint64_t address, size_t length) const
+    {
+        // Segments are sorted by address
+        auto iter = std::upper_bound(segments.begin(), segments.end(), address, [ ] (uint64_t value, const view_segment& segment)
+        {
+            return value < segment.start;
+        });
+
+        if (iter == segments.begin())
+        {
+            return nullptr;
+        }
+
+        const view_segment& segment = *--iter;
+
+        const uint64_t offset = address - segment.start;
+
+        if ((offset > segment.length) || (length > segment.length - offset))
+        {
+            return nullptr;
+        }
+
+        return segment.data + offset;
+    }
+
+    bool view_data::match(uint64_t address, const mem::pattern& pattern) const
+    {
+        const size_t length = pattern.size();
+        const uint8_t* data = find(address, length);
+
+        if (!data)
+        {
+            return false;
+        }
+
+        const mem::byte* bytes = pattern.bytes();
+        const mem::byte* masks = pattern.masks();
+
+        for (size_t i = 0; i < length; ++i)
+        {
+            if ((data[i] ^ bytes[i]) & masks[i])
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool view_data::read(uint64_t address, void* buffer, size_t length) const
+    {
+        const uint8_t* data = find(address, length);
+
+        if (!data)
+        {
+            return false;
+        }
+
+        std::memcpy(buffer, data, length);
+
+        return true;
+    }
+
+    const byte_histogram& view_data::histogram() const
+    {
+        std::call_once(histogram_once_, [this]
+        {
+            std::mutex lock;
+
+            for (const view_segment& segment : segments)
+            {
+                parallel_partition(static_cast<size_t>(segment.length), scan_partition_size, 0,
+                    [&] (size_t offset, size_t length) -> bool
+                {
+                    // Separate tables avoid stalls when the same byte repeats
+                    uint32_t counts[4][256] {};
+
+                    const uint8_t* data = segment.data + offset;
+                    size_t i = 0;
+
+                    for (; i + 4 <= length; i += 4)
+                    {
+                        ++counts[0][data[i + 0]];
+                        ++counts[1][data[i + 1]];
+                        ++counts[2][data[i + 2]];
+                        ++counts[3][data[i + 3]];
+                    }
+
+                    for (; i < length; ++i)
+                    {
+                        ++counts[0][data[i]];
+                    }
+
+                    std::lock_guard<std::mutex> guard(lock);
+
+                    for (size_t j = 0; j < 256; ++j)
+                    {
+                        histogram_[j] += uint64_t(counts[0][j]) + counts[1][j] + counts[2][j] + counts[3][j];
+                    }
+
+                    return true;
+                });
+            }
+        });
+
+        return histogram_;
+    }
+}
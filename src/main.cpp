@@ -28,6 +28,7 @@ extern "C"
     {
         PluginCommand::Register("Pattern\\Scan for Pattern", "Scans for an array of bytes", &ScanForArrayOfBytes);
         PluginCommand::Register("Pattern\\Load Pattern File", "Loads a file containing patterns", &LoadPatternFile);
+        PluginCommand::Register("Pattern\\Convert Pattern File", "Converts a pattern file into a precompiled pattern database", &ConvertPatternFile);
 
         PluginCommand::RegisterForAddress("Pattern\\Create Signature", "Creates a signature", &GenerateSignature, [ ] (Ref<BinaryView> view, uint64_t addr) -> bool
         {
@@ -46,6 +47,10 @@ extern "C"
             return (arch_name == "x86") || (arch_name == "x86_64");
         });
 
+        PluginCommand::Register("Pattern\\Create Signatures for All Functions", "Creates a pattern file containing a signature for every function", &GenerateSignatures);
+        PluginCommand::RegisterForRange("Pattern\\Create Signatures for Selected Functions", "Creates a pattern file containing a signature for every function in the selection", &GenerateSelectionSignatures);
+        PluginCommand::Register("Pattern\\Create Signatures for All Symbols", "Creates a pattern file containing a signature for every named function symbol", &GenerateSymbolSignatures);
+
         BinjaLog(InfoLog, "Loaded binja-pattern");
 
         return true;